@@ -2,6 +2,7 @@
 
 #include <string>
 #include <system_error>
+#include <tuple>
 #include <utility>
 
 #include <assert.h>
@@ -13,12 +14,18 @@ extern "C" {
     #include "internal/ut_manager/ut.h"
 }
 
+#include "internal/ObjectCache.h"
+
 // std::unique_ptr-like class for caps
 
 template <seL4_Word Type, seL4_Word SizeBits>
 class Capability {
     public:
         Capability() {
+            std::tie(_memory, _cap) = ObjectCache<Type, SizeBits>::get().take();
+            if (_cap != 0)
+                return;
+
             _memory = ut_alloc(SizeBits);
             if (_memory == 0)
                 throw std::system_error(ENOMEM, std::system_category(), "Failed to allocate seL4 memory");
@@ -64,6 +71,13 @@ class Capability {
         }
 
         void reset() noexcept {
+            // Externally managed caps have no memory, so can't be cached
+            if (_cap != 0 && _memory != 0 && ObjectCache<Type, SizeBits>::get().give(_memory, _cap)) {
+                _cap = 0;
+                _memory = 0;
+                return;
+            }
+
             if (_cap != 0)
                 assert(cspace_delete_cap(cur_cspace, _cap) == CSPACE_NOERROR);
             if (_memory != 0)
@@ -0,0 +1,599 @@
+#pragma once
+
+#include <exception>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "internal/async.h"
+
+// Member functions here are called then() too, so keep the executor
+// injecting macro out of the way while defining them
+#pragma push_macro("then")
+#undef then
+
+namespace async {
+
+// A lightweight alternative to boost::future for hot paths.
+//
+// Futures that are already ready hold their result inline, so creating one
+// and chaining then() on it never allocates outside of a deferral. A pending
+// future shares a single reference counted state with its promise, which
+// stores the continuation inline when it is small enough and is recycled
+// through a free list. Everything is single threaded, and continuations go
+// through their executor like boost::future's do: they run inline unless the
+// run queue is deferring, in which case they're posted to it.
+//
+// The interface follows boost::future closely (then(), get(), is_ready(),
+// unwrap(), ...) so code can be moved over piecemeal, and futures convert
+// from and to boost::future at the boundaries.
+template <typename T> class Future;
+template <typename T> class Promise;
+
+template <typename T> Future<T> makeExceptionalFuture(std::exception_ptr e);
+Future<void> makeReadyFuture();
+
+struct _Unit {};
+
+template <typename T>
+using _Stored = std::conditional_t<std::is_void<T>::value, _Unit, T>;
+
+template <typename T>
+class _Result {
+    public:
+        _Result() noexcept {}
+        _Result(_Result&& other) {
+            _moveFrom(other);
+        }
+        _Result& operator=(_Result&& other) {
+            if (this != &other) {
+                reset();
+                _moveFrom(other);
+            }
+            return *this;
+        }
+        ~_Result() {
+            reset();
+        }
+
+        bool isSet() const noexcept {return _kind != Kind::EMPTY;}
+        bool hasValue() const noexcept {return _kind == Kind::VALUE;}
+        bool hasException() const noexcept {return _kind == Kind::EXCEPTION;}
+
+        template <typename ...Args>
+        void setValue(Args&& ...args) {
+            assert(!isSet());
+            new (&_value) _Stored<T>(std::forward<Args>(args)...);
+            _kind = Kind::VALUE;
+        }
+
+        void setException(std::exception_ptr e) noexcept {
+            assert(!isSet());
+            new (&_exception) std::exception_ptr(std::move(e));
+            _kind = Kind::EXCEPTION;
+        }
+
+        // Moves the value out (or throws the exception), leaving it empty
+        _Stored<T> take() {
+            assert(isSet());
+            if (_kind == Kind::EXCEPTION) {
+                std::exception_ptr e = std::move(_exception);
+                reset();
+                std::rethrow_exception(e);
+            }
+
+            _Stored<T> value(std::move(_value));
+            reset();
+            return value;
+        }
+
+        void reset() noexcept {
+            if (_kind == Kind::VALUE)
+                _value.~Stored();
+            else if (_kind == Kind::EXCEPTION)
+                _exception.~exception_ptr();
+            _kind = Kind::EMPTY;
+        }
+
+    private:
+        using Stored = _Stored<T>;
+
+        void _moveFrom(_Result& other) {
+            if (other._kind == Kind::VALUE)
+                setValue(std::move(other._value));
+            else if (other._kind == Kind::EXCEPTION)
+                setException(std::move(other._exception));
+            other.reset();
+        }
+
+        enum class Kind : uint8_t {EMPTY, VALUE, EXCEPTION} _kind = Kind::EMPTY;
+        union {
+            _Stored<T> _value;
+            std::exception_ptr _exception;
+        };
+};
+
+// A one-shot, move-only std::function<void (Arg)> that keeps small callables
+// inline instead of on the heap
+template <typename Arg>
+class _Continuation {
+    public:
+        _Continuation() noexcept {}
+        ~_Continuation() {
+            reset();
+        }
+
+        _Continuation(const _Continuation&) = delete;
+        _Continuation& operator=(const _Continuation&) = delete;
+
+        explicit operator bool() const noexcept {return _invoke != nullptr;}
+
+        template <typename F>
+        void set(F&& f) {
+            using Callable = std::decay_t<F>;
+            assert(!*this);
+
+            _set<Callable>(std::forward<F>(f), std::integral_constant<bool,
+                sizeof(Callable) <= sizeof(_storage) && alignof(Callable) <= alignof(_Storage)
+            >());
+            _invoke = [](void* target, Arg&& arg) {
+                (*static_cast<Callable*>(target))(std::move(arg));
+            };
+        }
+
+        void operator()(Arg arg) {
+            assert(*this);
+            _invoke(_target, std::move(arg));
+            reset();
+        }
+
+        void reset() noexcept {
+            if (_destroy)
+                _destroy(_target);
+            _invoke = nullptr;
+            _destroy = nullptr;
+            _target = nullptr;
+        }
+
+    private:
+        template <typename Callable, typename F>
+        void _set(F&& f, std::true_type /*isInline*/) {
+            _target = new (&_storage) Callable(std::forward<F>(f));
+            _destroy = [](void* target) {
+                static_cast<Callable*>(target)->~Callable();
+            };
+        }
+
+        template <typename Callable, typename F>
+        void _set(F&& f, std::false_type /*isInline*/) {
+            _target = new Callable(std::forward<F>(f));
+            _destroy = [](void* target) {
+                delete static_cast<Callable*>(target);
+            };
+        }
+
+        using _Storage = std::aligned_storage_t<8 * sizeof(void*)>;
+        _Storage _storage;
+
+        void* _target = nullptr;
+        void (*_invoke)(void*, Arg&&) = nullptr;
+        void (*_destroy)(void*) = nullptr;
+};
+
+template <typename T>
+class _State {
+    public:
+        _State(const _State&) = delete;
+        _State& operator=(const _State&) = delete;
+
+        void addRef() noexcept {
+            ++_refs;
+        }
+        void release() noexcept {
+            if (--_refs == 0)
+                delete this;
+        }
+
+        // Runs the continuation, if any, through its executor. Must be called
+        // once the result is set
+        void complete();
+
+        // Freed states are kept for reuse, since every pending operation
+        // needs one
+        static void* operator new(size_t size) {
+            assert(size == sizeof(_State));
+            if (_freeList) {
+                void* state = _freeList;
+                _freeList = _freeList->next;
+                return state;
+            }
+            return ::operator new(size);
+        }
+        static void operator delete(void* state) noexcept {
+            _freeList = new (state) _FreeState{_freeList};
+        }
+
+        _Result<T> result;
+        _Continuation<Future<T>> continuation;
+        Executor* executor = nullptr;
+        bool isRetrieved = false;
+
+    private:
+        _State() = default;
+        ~_State() = default;
+
+        void _runContinuation();
+
+        size_t _refs = 1;
+
+        struct _FreeState {
+            _FreeState* next;
+        };
+        static _FreeState* _freeList;
+
+        template <typename U> friend class _StateRef;
+};
+
+template <typename T>
+typename _State<T>::_FreeState* _State<T>::_freeList = nullptr;
+
+template <typename T>
+class _StateRef {
+    public:
+        _StateRef() noexcept: _state(nullptr) {}
+        static _StateRef create() {
+            return _StateRef(new _State<T>);
+        }
+
+        _StateRef(const _StateRef& other) noexcept: _state(other._state) {
+            if (_state)
+                _state->addRef();
+        }
+        _StateRef(_StateRef&& other) noexcept: _state(other._state) {
+            other._state = nullptr;
+        }
+        _StateRef& operator=(_StateRef other) noexcept {
+            std::swap(_state, other._state);
+            return *this;
+        }
+        ~_StateRef() {
+            if (_state)
+                _state->release();
+        }
+
+        _State<T>* operator->() const noexcept {return _state;}
+        explicit operator bool() const noexcept {return _state != nullptr;}
+
+    private:
+        explicit _StateRef(_State<T>* state) noexcept: _state(state) {}
+
+        _State<T>* _state;
+
+        friend class _State<T>;
+};
+
+// Invokes f(arg) and stores whatever it returns or throws into result
+template <typename F, typename Arg, typename R>
+void _invokeInto(_Result<R>& result, F& f, Arg&& arg, std::false_type /*isVoid*/) noexcept {
+    try {
+        result.setValue(f(std::forward<Arg>(arg)));
+    } catch (...) {
+        result.setException(std::current_exception());
+    }
+}
+
+template <typename F, typename Arg, typename R>
+void _invokeInto(_Result<R>& result, F& f, Arg&& arg, std::true_type /*isVoid*/) noexcept {
+    try {
+        f(std::forward<Arg>(arg));
+        result.setValue();
+    } catch (...) {
+        result.setException(std::current_exception());
+    }
+}
+
+template <typename F, typename Arg, typename R>
+void _invokeInto(_Result<R>& result, F& f, Arg&& arg) noexcept {
+    _invokeInto(result, f, std::forward<Arg>(arg), std::is_void<R>());
+}
+
+// Completes a promise (ours or boost's) with the result of a future (ours or
+// boost's)
+template <typename P, typename F>
+void _forward(P& promise, F&& future, std::false_type /*isVoid*/) noexcept {
+    try {
+        promise.set_value(future.get());
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+template <typename P, typename F>
+void _forward(P& promise, F&& future, std::true_type /*isVoid*/) noexcept {
+    try {
+        future.get();
+        promise.set_value();
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+template <typename T, typename P, typename F>
+void _forward(P& promise, F&& future) noexcept {
+    _forward(promise, std::forward<F>(future), std::is_void<T>());
+}
+
+template <typename T>
+class Future {
+    public:
+        using value_type = T;
+
+        Future() noexcept = default;
+        Future(Future&&) = default;
+        Future& operator=(Future&&) = default;
+
+        Future(const Future&) = delete;
+        Future& operator=(const Future&) = delete;
+
+        // Takes over a boost::future. Doesn't allocate if it's already ready
+        Future(future<T>&& other) {
+            if (other.is_ready()) {
+                _fromBoost(other, std::is_void<T>());
+                return;
+            }
+
+            Promise<T> promise;
+            *this = promise.get_future();
+            auto sharedPromise = std::make_shared<Promise<T>>(std::move(promise));
+            other.then(asyncExecutor, [sharedPromise](future<T> result) {
+                _forward<T>(*sharedPromise, std::move(result));
+            });
+        }
+
+        bool valid() const noexcept {
+            return _ready.isSet() || _state;
+        }
+        bool is_ready() const noexcept {
+            return _ready.isSet() || (_state && _state->result.isSet());
+        }
+        bool has_value() const noexcept {
+            return _ready.hasValue() || (_state && _state->result.hasValue());
+        }
+        bool has_exception() const noexcept {
+            return _ready.hasException() || (_state && _state->result.hasException());
+        }
+
+        // Like boost::future, this invalidates the future. Unlike
+        // boost::future, there is nothing to wait on so it must be ready
+        T get() {
+            assert(is_ready());
+            if (_state) {
+                _StateRef<T> state = std::move(_state);
+                return static_cast<T>(state->result.take());
+            }
+            return static_cast<T>(_ready.take());
+        }
+
+        // Calls f(Future<T>) once this is ready, returning a future of
+        // whatever f returns. f is submitted to the executor, so it is queued
+        // rather than run inline while the run queue is deferring
+        template <typename F>
+        auto then(Executor& executor, F&& f) {
+            return _then(std::forward<F>(f), &executor);
+        }
+
+        // Future<Future<U>> -> Future<U>
+        template <typename U = T>
+        auto unwrap() -> decltype(U().get(), Future<typename U::value_type>()) {
+            using Inner = typename U::value_type;
+
+            if (is_ready()) {
+                try {
+                    return get();
+                } catch (...) {
+                    return makeExceptionalFuture<Inner>(std::current_exception());
+                }
+            }
+
+            Promise<Inner> promise;
+            Future<Inner> result = promise.get_future();
+            _then([promise = std::move(promise)](Future<U> outer) mutable {
+                try {
+                    outer.get()._then([promise = std::move(promise)](Future<Inner> inner) mutable {
+                        _forward<Inner>(promise, std::move(inner));
+                    });
+                } catch (...) {
+                    promise.set_exception(std::current_exception());
+                }
+            });
+            return result;
+        }
+
+        // For handing the result to code that still expects a boost::future
+        future<T> toBoostFuture() {
+            if (is_ready()) {
+                promise<T> result;
+                _forward<T>(result, std::move(*this));
+                return result.get_future();
+            }
+
+            auto result = std::make_shared<promise<T>>();
+            future<T> resultFuture = result->get_future();
+            _then([result](Future<T> self) {
+                _forward<T>(*result, std::move(self));
+            });
+            return resultFuture;
+        }
+
+    private:
+        explicit Future(_StateRef<T> state) noexcept: _state(std::move(state)) {}
+
+        // Without an executor, f always runs inline. That's only for
+        // plumbing between futures, which the continuations at either end
+        // are scheduled by
+        template <typename F>
+        auto _then(F&& f, Executor* executor = nullptr) {
+            using Callable = std::decay_t<F>;
+            using R = std::result_of_t<Callable&(Future<T>)>;
+            assert(valid());
+
+            Future<R> next;
+            if (is_ready() && !(executor && RunQueue::get().isDeferring())) {
+                Callable callable(std::forward<F>(f));
+                _invokeInto(next._ready, callable, std::move(*this));
+                return next;
+            }
+
+            // Ready futures that have to wait for the run queue need a state
+            // to queue with
+            _StateRef<T> state = std::move(_state);
+            if (!state) {
+                state = _StateRef<T>::create();
+                state->result = std::move(_ready);
+            }
+
+            next._state = _StateRef<R>::create();
+            state->executor = executor;
+            state->continuation.set([nextState = next._state, f = Callable(std::forward<F>(f))](Future<T> self) mutable {
+                _invokeInto(nextState->result, f, std::move(self));
+                nextState->complete();
+            });
+            if (state->result.isSet())
+                state->complete();
+
+            return next;
+        }
+
+        void _fromBoost(future<T>& other, std::false_type /*isVoid*/) {
+            try {
+                _ready.setValue(other.get());
+            } catch (...) {
+                _ready.setException(std::current_exception());
+            }
+        }
+
+        void _fromBoost(future<T>& other, std::true_type /*isVoid*/) {
+            try {
+                other.get();
+                _ready.setValue();
+            } catch (...) {
+                _ready.setException(std::current_exception());
+            }
+        }
+
+        _Result<T> _ready;
+        _StateRef<T> _state;
+
+        template <typename U> friend class Future;
+        friend class Promise<T>;
+        friend class _State<T>;
+        template <typename U> friend Future<std::decay_t<U>> makeReadyFuture(U&& value);
+        friend Future<void> makeReadyFuture();
+        template <typename U> friend Future<U> makeExceptionalFuture(std::exception_ptr e);
+};
+
+template <typename T>
+void _State<T>::complete() {
+    assert(result.isSet());
+    if (!continuation)
+        return;
+
+    if (executor) {
+        addRef();
+        executor->submit([self = _StateRef<T>(this)] {
+            self->_runContinuation();
+        });
+    } else {
+        _runContinuation();
+    }
+}
+
+template <typename T>
+void _State<T>::_runContinuation() {
+    addRef();
+    continuation(Future<T>(_StateRef<T>(this)));
+}
+
+template <typename T>
+class Promise {
+    public:
+        Promise(): _state(_StateRef<T>::create()) {}
+        Promise(Promise&&) noexcept = default;
+        Promise& operator=(Promise&& other) noexcept {
+            if (this != &other) {
+                _abandon();
+                _state = std::move(other._state);
+            }
+            return *this;
+        }
+        ~Promise() {
+            _abandon();
+        }
+
+        Promise(const Promise&) = delete;
+        Promise& operator=(const Promise&) = delete;
+
+        Future<T> get_future() {
+            assert(_state && !_state->isRetrieved);
+            _state->isRetrieved = true;
+            return Future<T>(_state);
+        }
+
+        template <typename ...Args>
+        void set_value(Args&& ...args) {
+            _state->result.setValue(std::forward<Args>(args)...);
+            _state->complete();
+        }
+
+        void set_exception(std::exception_ptr e) {
+            _state->result.setException(std::move(e));
+            _state->complete();
+        }
+
+        template <typename E>
+        void set_exception(E e) {
+            set_exception(std::make_exception_ptr(std::move(e)));
+        }
+
+    private:
+        void _abandon() noexcept {
+            if (_state && !_state->result.isSet())
+                set_exception(boost::broken_promise());
+            _state = _StateRef<T>();
+        }
+
+        _StateRef<T> _state;
+};
+
+template <typename T>
+Future<std::decay_t<T>> makeReadyFuture(T&& value) {
+    Future<std::decay_t<T>> result;
+    result._ready.setValue(std::forward<T>(value));
+    return result;
+}
+
+inline Future<void> makeReadyFuture() {
+    Future<void> result;
+    result._ready.setValue();
+    return result;
+}
+
+template <typename T>
+Future<T> makeExceptionalFuture(std::exception_ptr e) {
+    Future<T> result;
+    result._ready.setException(std::move(e));
+    return result;
+}
+
+template <typename T, typename E>
+Future<T> makeExceptionalFuture(E e) {
+    return makeExceptionalFuture<T>(std::make_exception_ptr(std::move(e)));
+}
+
+}
+
+#pragma pop_macro("then")
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <utility>
+#include <vector>
+
+#include <assert.h>
+
+extern "C" {
+    #include <cspace/cspace.h>
+    #include <sel4/sel4.h>
+    #include <sel4/types.h>
+
+    #include "internal/ut_manager/ut.h"
+}
+
+// Keeps a reserve of already retyped seL4 objects, so that creating one
+// doesn't need to retype memory on the critical path. Returned objects are
+// recycled and kept for reuse instead of being destroyed
+
+template <seL4_Word Type, seL4_Word SizeBits>
+class ObjectCache {
+    public:
+        // Only these types are worth caching, since they're created and
+        // destroyed during page faults and process creation
+        static constexpr size_t CAPACITY =
+            Type == seL4_ARM_SmallPageObject ? 32 :
+            Type == seL4_ARM_PageTableObject ? 16 :
+            Type == seL4_TCBObject ? 8 :
+            Type == seL4_EndpointObject ? 8 :
+            0;
+        static constexpr size_t RESERVE = CAPACITY / 2;
+
+        // Returns {0, 0} if there is nothing cached
+        std::pair<seL4_Word, seL4_CPtr> take() noexcept {
+            if (_objects.empty())
+                return std::make_pair(0, 0);
+
+            auto object = _objects.back();
+            _objects.pop_back();
+            return object;
+        }
+
+        // Returns false if the object wasn't taken, and so should be
+        // destroyed by the caller instead
+        bool give(seL4_Word memory, seL4_CPtr cap) noexcept {
+            if (_objects.size() >= CAPACITY)
+                return false;
+
+            // Revokes all derived caps and returns the object to its initial
+            // state. cspace_recycle_cap() can't be used, since it aborts
+            // instead of reporting failure
+            if (seL4_CNode_Recycle(cur_cspace->root_cnode, cap, CSPACE_DEPTH) != seL4_NoError)
+                return false;
+
+            _objects.push_back(std::make_pair(memory, cap));
+            return true;
+        }
+
+        // Retypes new objects until the reserve is full, or memory runs out
+        void refill() noexcept {
+            while (_objects.size() < RESERVE) {
+                seL4_Word memory = ut_alloc(SizeBits);
+                if (memory == 0)
+                    return;
+
+                seL4_CPtr cap;
+                if (cspace_ut_retype_addr(memory, Type, SizeBits, cur_cspace, &cap) != seL4_NoError) {
+                    ut_free(memory, SizeBits);
+                    return;
+                }
+                assert(cap != 0);
+
+                _objects.push_back(std::make_pair(memory, cap));
+            }
+        }
+
+        static ObjectCache& get() noexcept {
+            static ObjectCache cache;
+            return cache;
+        }
+
+    private:
+        ObjectCache() {
+            _objects.reserve(CAPACITY);
+        }
+
+        std::vector<std::pair<seL4_Word, seL4_CPtr>> _objects;
+};
+
+// Keeps a reserve of empty slots in SOS' cspace, so that copying caps, such as
+// when a page is shared or swapped back in for all its copies, takes slots
+// from the allocator and hands them back in batches rather than one at a time
+class SlotCache {
+    public:
+        static constexpr size_t CAPACITY = 64;
+        static constexpr size_t BATCH = 16;
+
+        // Copies cap into n new slots. Either all the copies are made, or none
+        // are and false is returned
+        bool copy(seL4_CPtr cap, size_t n, seL4_CPtr* copies) noexcept;
+        // Returns CSPACE_NULL on failure
+        seL4_CPtr copy(seL4_CPtr cap) noexcept {
+            seL4_CPtr result;
+            return copy(cap, 1, &result) ? result : CSPACE_NULL;
+        }
+
+        // Deletes the caps, keeping their slots for reuse
+        void remove(size_t n, const seL4_CPtr* caps) noexcept;
+        void remove(seL4_CPtr cap) noexcept {
+            remove(1, &cap);
+        }
+
+        // Allocates slots until the reserve is half full
+        void refill() noexcept;
+
+        static SlotCache& get() noexcept {
+            static SlotCache cache;
+            return cache;
+        }
+
+    private:
+        SlotCache() = default;
+
+        bool _take(size_t n, seL4_CPtr* slots) noexcept;
+        void _give(size_t n, const seL4_CPtr* slots) noexcept;
+
+        std::array<seL4_CPtr, CAPACITY> _slots;
+        size_t _count = 0;
+};
+
+// Tops up all the caches. Should be called when there is nothing more urgent
+// to do
+void refillObjectCaches() noexcept;
@@ -1,25 +1,125 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <memory>
+#include <queue>
 #include <utility>
 
 #define syscall(...) _syscall(__VA_ARGS__)
-// Includes missing from inline_executor.hpp
-#include <boost/thread/thread.hpp>
-#include <boost/thread/concurrent_queues/sync_queue.hpp>
-
-#include <boost/thread/executors/inline_executor.hpp>
 #include <boost/thread/future.hpp>
 #undef syscall
 
+namespace async {
+
+// Continuations that become runnable while handling an interrupt are queued
+// here and run later from the main loop, instead of recursively inside the
+// network or timer code that completed them. Everywhere else they still run
+// straight away, so futures that are ready stay ready through then().
+class RunQueue {
+    public:
+        // In the order they get run
+        enum class Priority {
+            URGENT_REPLY, // Resuming threads of processes with a negative nice
+            REPLY,        // Resuming user threads
+            NICE_REPLY,   // ... and of processes with a positive nice
+            NORMAL,
+            BACKGROUND,   // Nothing is directly waiting on it
+            COUNT
+        };
+
+        static RunQueue& get() noexcept;
+
+        void post(Priority priority, std::function<void ()> f);
+
+        // Runs at most budget queued functions, highest priority first, and
+        // returns how many were run
+        size_t run(size_t budget);
+
+        bool isEmpty() const noexcept;
+        bool isDeferring() const noexcept {return _isDeferring;}
+
+        // Continuations are posted rather than run while one of these exists
+        class Deferral {
+            public:
+                Deferral() noexcept;
+                ~Deferral();
+
+                Deferral(const Deferral&) = delete;
+                Deferral& operator=(const Deferral&) = delete;
+
+            private:
+                bool _wasDeferring;
+        };
+
+        // ... and always run straight away while one of these exists, for
+        // code that relies on ready futures staying ready
+        class Inline {
+            public:
+                Inline() noexcept;
+                ~Inline();
+
+                Inline(const Inline&) = delete;
+                Inline& operator=(const Inline&) = delete;
+
+            private:
+                bool _wasDeferring;
+        };
+
+    private:
+        RunQueue() = default;
+
+        std::queue<std::function<void ()>> _queues[static_cast<size_t>(Priority::COUNT)];
+        bool _isDeferring = false;
+};
+
+// Submits continuations to the run queue with a fixed priority. Implements
+// what boost::future::then() needs from an executor
+class Executor {
+    public:
+        explicit Executor(RunQueue::Priority priority) noexcept:
+            _priority(priority) {}
+
+        void close() noexcept {}
+        bool closed() const noexcept {return false;}
+
+        template <typename Closure>
+        void submit(Closure&& closure) {
+            RunQueue& runQueue = RunQueue::get();
+            if (runQueue.isDeferring())
+                runQueue.post(_priority, std::forward<Closure>(closure));
+            else
+                closure();
+        }
+
+        bool try_executing_one() {
+            return RunQueue::get().run(1) != 0;
+        }
+
+    private:
+        RunQueue::Priority _priority;
+};
+
+extern Executor asyncExecutor;
+extern Executor urgentReplyExecutor;
+extern Executor replyExecutor;
+extern Executor niceReplyExecutor;
+extern Executor backgroundExecutor;
+
+// then() on a different executor, since the then() macro below always uses
+// asyncExecutor
+template <typename Future, typename F>
+auto thenOn(Executor& executor, Future&& future, F&& f) {
+    return std::forward<Future>(future).then(executor, std::forward<F>(f));
+}
+
+}
+
 #define then(...) then(::async::asyncExecutor, __VA_ARGS__)
 
 namespace async {
 
-extern boost::inline_executor asyncExecutor;
-
 using boost::promise;
 using boost::future;
 using boost::make_ready_future;
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace benchmark {
+
+/**
+ * Runs all the microbenchmarks and prints their results.
+ * Requires the timer to be initialised.
+ */
+void run() noexcept;
+
+}
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include "internal/async.h"
 #include "internal/process/Thread.h"
 
 namespace elf {
 
-async::future<memory::vaddr_t> load(std::shared_ptr<process::Process> process, uint8_t* file);
+// An executable's headers and loadable segments, at the same offsets as in
+// the file. Anything else in the file might be left out
+using Image = std::shared_ptr<uint8_t>;
+
+// Looks in the boot image first, then the root file system. Images from the
+// file system are cached until they're modified
+async::future<Image> open(const std::string& pathname);
+
+async::future<memory::vaddr_t> load(std::shared_ptr<process::Process> process, Image image);
 
 }
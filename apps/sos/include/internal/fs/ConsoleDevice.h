@@ -16,6 +16,10 @@ class ConsoleDevice : public File {
 
         virtual async::future<int> ioctl(size_t request, memory::UserMemory argp) override;
 
+        virtual short getReadiness() override;
+        virtual void addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) override;
+        virtual void removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept override;
+
     protected:
         virtual async::future<ssize_t> _readOne(const IoVector& iov, off64_t offset) override;
         virtual async::future<ssize_t> _writeOne(const IoVector& iov, off64_t offset) override;
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include "internal/fs/File.h"
+
+namespace fs {
+
+// The interest set behind an epoll file descriptor. Only level triggered
+// events are supported, optionally with EPOLLONESHOT. Waiters on it are
+// waiting on every file in the set, including ones added while they wait
+class EventPoll : public File {
+    public:
+        void add(int fd, std::shared_ptr<File> file, epoll_event event);
+        void modify(int fd, std::shared_ptr<File> file, epoll_event event);
+        void remove(int fd, std::shared_ptr<File> file);
+
+        // At most maxEvents of the ready events, in file descriptor order.
+        // EPOLLONESHOT interests are disabled once they're returned here
+        std::vector<epoll_event> getReadyEvents(size_t maxEvents);
+        std::vector<std::shared_ptr<File>> getFiles();
+
+        virtual short getReadiness() override;
+        virtual void addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) override;
+        virtual void removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept override;
+
+    private:
+        struct Interest {
+            std::weak_ptr<File> file;
+            epoll_event event;
+        };
+
+        // Interests in files that have since been closed are dropped as
+        // they're found
+        std::map<int, Interest>::iterator _find(int fd, const std::shared_ptr<File>& file);
+        static uint32_t _getReadyEvents(const Interest& interest, File& file);
+
+        std::map<int, Interest> _interests;
+        ReadinessWaiters _readinessWaiters;
+};
+
+}
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/stat.h>
 
 #include "internal/async.h"
@@ -20,15 +23,50 @@ struct IoVector {
     size_t length;
 };
 
+// Something blocked in poll() or epoll_wait() until a file is ready
+class ReadinessWaiter {
+    public:
+        virtual ~ReadinessWaiter() = default;
+
+        virtual void notify() noexcept = 0;
+        // Once it stops waiting, such as on a timeout or because another file
+        // became ready, notifying it does nothing
+        virtual bool isFinished() const noexcept = 0;
+};
+
+// The waiters on a file's readiness. Each one is only notified once, and has
+// to add itself back if it wants to keep waiting. Waiters remove themselves
+// when they finish, and any that were missed (such as through a file that
+// has since left an epoll set) are dropped as new ones are added, so files
+// that rarely notify don't build up a backlog of them
+class ReadinessWaiters {
+    public:
+        void add(std::shared_ptr<ReadinessWaiter> waiter);
+        void remove(const ReadinessWaiter& waiter) noexcept;
+        void notifyAll() noexcept;
+
+    private:
+        std::vector<std::shared_ptr<ReadinessWaiter>> _waiters;
+};
+
 class File {
     public:
         virtual ~File() = default;
 
         virtual async::future<ssize_t> read(const std::vector<IoVector>& iov, off64_t offset);
-        virtual async::future<ssize_t> write(const std::vector<IoVector>& iov, off64_t offset);
+        // Non-blocking writes to files that can fill up return what fit, or
+        // fail with EAGAIN if nothing did, rather than waiting for room
+        virtual async::future<ssize_t> write(const std::vector<IoVector>& iov, off64_t offset, bool isNonBlocking = false);
 
         virtual async::future<int> ioctl(size_t request, memory::UserMemory argp);
 
+        // The poll() events that are currently ready. Files that never block
+        // are always readable and writable, and so never need to notify
+        // anyone either
+        virtual short getReadiness();
+        virtual void addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter);
+        virtual void removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept;
+
     protected:
         virtual async::future<ssize_t> _readOne(const IoVector& iov, off64_t offset);
         virtual async::future<ssize_t> _writeOne(const IoVector& iov, off64_t offset);
@@ -39,7 +77,7 @@ class Directory : public File {
         virtual ~Directory() = default;
 
         virtual async::future<ssize_t> read(const std::vector<IoVector>& iov, off64_t offset) override;
-        virtual async::future<ssize_t> write(const std::vector<IoVector>& iov, off64_t offset) override;
+        virtual async::future<ssize_t> write(const std::vector<IoVector>& iov, off64_t offset, bool isNonBlocking = false) override;
 
         virtual async::future<ssize_t> getdents(memory::UserMemory dirp, size_t length) = 0;
 
@@ -47,6 +85,17 @@ class Directory : public File {
         static dirent* _alignNextDirent(dirent* curDirent, size_t nameLength);
 };
 
+// Copies up to `count` bytes from `in` to `out` through a buffer in SOS,
+// reading the next chunk while the previous one is being written. Like read()
+// and write(), returns how much was copied if an error happens after some of
+// it was
+async::future<ssize_t> copy(std::shared_ptr<File> in, off64_t inOffset, std::shared_ptr<File> out, off64_t outOffset, size_t count);
+
+// Resolves with what check() returns once it's non-zero, checking again each
+// time one of the files might have become ready. After timeout milliseconds
+// (unless it's negative) it resolves with whatever check() returns then
+async::future<int> waitForReadiness(std::vector<std::shared_ptr<File>> files, std::function<int ()> check, int timeout);
+
 class FileSystem {
     public:
         struct OpenFlags {
@@ -16,26 +16,51 @@ class OpenFile {
             bool read:1, write:1;
         };
 
-        OpenFile(std::shared_ptr<File> file, Flags flags);
+        OpenFile(std::shared_ptr<File> file, Flags flags, bool isNonBlocking = false);
 
         std::shared_ptr<File> get(Flags flags) const;
+        Flags getFlags() const noexcept {return _flags;}
+
+        // Reads and writes that would block fail with EAGAIN instead
+        bool isNonBlocking() const noexcept {return _isNonBlocking;}
+        void setNonBlocking(bool isNonBlocking) noexcept {_isNonBlocking = isNonBlocking;}
 
     private:
         std::shared_ptr<File> _file;
         Flags _flags;
+        bool _isNonBlocking;
 };
 
 class FDTable {
     public:
-        FileDescriptor insert(std::shared_ptr<OpenFile> file);
+        // Uses the lowest free file descriptor at or above `minFd`
+        FileDescriptor insert(std::shared_ptr<OpenFile> file, bool isCloseOnExec = false, FileDescriptor minFd = 0);
+        // Replaces whatever was open at `fd` already, like dup2()
+        void insertAt(FileDescriptor fd, std::shared_ptr<OpenFile> file, bool isCloseOnExec = false);
         bool erase(FileDescriptor fd) noexcept;
         void clear() noexcept;
 
         std::shared_ptr<OpenFile> get(FileDescriptor fd) const;
         std::shared_ptr<File> get(FileDescriptor fd, OpenFile::Flags flags) const;
 
+        // Close-on-exec belongs to the file descriptor rather than the open
+        // file, so duplicates don't share it
+        bool isCloseOnExec(FileDescriptor fd) const;
+        void setCloseOnExec(FileDescriptor fd, bool isCloseOnExec);
+
+        // What a new process starts with: everything except the close-on-exec
+        // file descriptors
+        FDTable forExec() const;
+
     private:
-        std::map<FileDescriptor, std::shared_ptr<OpenFile>> _table;
+        struct Entry {
+            std::shared_ptr<OpenFile> file;
+            bool isCloseOnExec;
+        };
+
+        const Entry& _getEntry(FileDescriptor fd) const;
+
+        std::map<FileDescriptor, Entry> _table;
 };
 
 }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <utility>
+
+#include "internal/fs/File.h"
+#include "internal/memory/FrameTable.h"
+#include "internal/memory/Page.h"
+
+namespace fs {
+
+// The buffer shared by both ends of a pipe: a queue of pages owned by SOS.
+// Only one transfer is in flight at a time, and requests are served in order,
+// so writes are never interleaved with each other
+class Pipe : public std::enable_shared_from_this<Pipe> {
+    public:
+        // Returns the read and write ends of a new pipe
+        static std::pair<std::shared_ptr<File>, std::shared_ptr<File>> create();
+
+        async::future<ssize_t> read(const IoVector& iov);
+        // A non-blocking write completes with what fit once the buffer fills
+        // up, or fails with EAGAIN if none of it did
+        async::future<ssize_t> write(const IoVector& iov, bool isNonBlocking);
+
+        short getReadReadiness() const noexcept;
+        short getWriteReadiness() const noexcept;
+        // Whether `bytes` more can be written without waiting for a reader
+        bool hasRoomFor(size_t bytes) const noexcept;
+        void addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter);
+        void removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept;
+
+        void closeReadEnd() noexcept;
+        void closeWriteEnd() noexcept;
+
+    private:
+        Pipe() = default;
+
+        struct Request {
+            IoVector iov;
+            size_t done;
+            bool isNonBlocking;
+            async::promise<ssize_t> promise;
+        };
+
+        void _process() noexcept;
+
+        // Each of these starts a transfer for the front request(s), which
+        // calls _process() again once it's done
+        void _readFromBuffer() noexcept;
+        void _writeToBuffer() noexcept;
+        void _handOff() noexcept;
+        void _finishTransfer(std::deque<Request>& requests, bool isComplete) noexcept;
+        void _failTransfer(std::deque<Request>& requests, std::exception_ptr exception) noexcept;
+
+        std::deque<memory::Page> _pages;
+        memory::Page _sparePage;
+        size_t _readOffset = 0; // Into the front page
+        size_t _writeOffset = PAGE_SIZE; // Into the back page
+        size_t _size = 0;
+
+        std::deque<Request> _readRequests;
+        std::deque<Request> _writeRequests;
+        bool _isTransferring = false;
+
+        bool _hasReadEnd = true;
+        bool _hasWriteEnd = true;
+        ReadinessWaiters _readinessWaiters;
+};
+
+class PipeReadEnd : public File {
+    public:
+        virtual ~PipeReadEnd() override;
+
+        virtual async::future<ssize_t> read(const std::vector<IoVector>& iov, off64_t offset) override;
+
+        virtual short getReadiness() override;
+        virtual void addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) override;
+        virtual void removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept override;
+
+    private:
+        PipeReadEnd(std::shared_ptr<Pipe> pipe): _pipe(std::move(pipe)) {}
+
+        std::shared_ptr<Pipe> _pipe;
+
+        friend class Pipe;
+};
+
+class PipeWriteEnd : public File {
+    public:
+        virtual ~PipeWriteEnd() override;
+
+        virtual async::future<ssize_t> write(const std::vector<IoVector>& iov, off64_t offset, bool isNonBlocking = false) override;
+
+        virtual short getReadiness() override;
+        virtual void addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) override;
+        virtual void removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept override;
+
+    private:
+        PipeWriteEnd(std::shared_ptr<Pipe> pipe): _pipe(std::move(pipe)) {}
+
+        std::shared_ptr<Pipe> _pipe;
+
+        friend class Pipe;
+};
+
+}
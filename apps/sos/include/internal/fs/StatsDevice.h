@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "internal/fs/File.h"
+
+namespace fs {
+
+class DeviceFileSystem;
+
+// Read-only text dump of the syscall and fault statistics, as they were when
+// the device was opened
+class StatsDevice : public File {
+    public:
+        static void mountOn(DeviceFileSystem& fs, const std::string& name);
+
+    protected:
+        virtual async::future<ssize_t> _readOne(const IoVector& iov, off64_t offset) override;
+
+    private:
+        explicit StatsDevice(std::string contents);
+
+        std::string _contents;
+        size_t _position;
+};
+
+}
@@ -53,6 +53,8 @@ class DeviceMemory {
             return &**this;
         }
 
+        vaddr_t getAddress() const noexcept {return _map.getAddress();}
+
     private:
         ScopedMapping _map;
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <limits.h>
+#include <stdint.h>
 
 extern "C" {
     #include <sel4/types.h>
@@ -51,27 +52,40 @@ namespace FrameTable {
 
             paddr_t getAddress() const;
 
+            // Returns where the frame can be accessed through SOS' frame
+            // window, mapping it in if this is the first access since the
+            // frame was allocated
+            uint8_t* getWindowAddress();
+
         private:
             Frame():
                 _pages(nullptr),
+                _windowCap(0),
                 _isLocked(false),
-                _isReferenced(false)
+                _isReferenced(false),
+                _isSwappingOut(false)
             {}
 
+            void _unmapWindow() noexcept;
+
             Page* _pages;
+            seL4_ARM_Page _windowCap;
 
             bool _isLocked:1;
             bool _isReferenced:1;
+            bool _isSwappingOut:1;
 
             friend class ::memory::Page;
             friend class ::memory::Swap;
             friend void init(paddr_t start, paddr_t end);
-            friend async::future<Page> alloc();
+            friend async::future<Page> alloc(int nice);
     };
 
     void init(paddr_t start, paddr_t end);
 
-    async::future<Page> alloc();
+    // If a frame has to be swapped out first, nice is that of whoever is
+    // waiting for it
+    async::future<Page> alloc(int nice = 0);
     Page alloc(paddr_t address);
 }
 
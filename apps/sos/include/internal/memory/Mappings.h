@@ -3,6 +3,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "internal/memory/PageDirectory.h"
@@ -14,6 +15,22 @@ namespace process {
 
 namespace memory {
 
+// Initial contents for a mapping's pages, copied in as each one is first
+// faulted in. Anything outside of the data is zero-filled
+struct Backing {
+    std::shared_ptr<const uint8_t> data;
+    vaddr_t start; // Where data[0] goes
+    size_t size;
+
+    // Only for read-only mappings. Each page is filled in once and kept here,
+    // and every process using this Backing maps a copy of the same frame
+    std::shared_ptr<std::unordered_map<vaddr_t, Page>> sharedPages;
+
+    // `page` is where the page at `address` can be written to, and must
+    // already be zeroed
+    void fill(uint8_t* page, vaddr_t address) const noexcept;
+};
+
 struct Mapping {
     vaddr_t start;
     vaddr_t end;
@@ -25,6 +42,8 @@ struct Mapping {
         bool stack:1;
         bool reserved:1; // Never map in this mapping
     } flags;
+
+    std::shared_ptr<const Backing> backing; // Zero-filled if none
 };
 class ScopedMapping;
 
@@ -33,8 +52,10 @@ class Mappings {
         Mappings(const Mappings&) = delete;
         Mappings& operator=(const Mappings&) = delete;
 
-        ScopedMapping insert(vaddr_t address, size_t pages, Attributes attributes, Mapping::Flags flags);
+        ScopedMapping insert(vaddr_t address, size_t pages, Attributes attributes, Mapping::Flags flags, std::shared_ptr<const Backing> backing = nullptr);
         void erase(vaddr_t address, size_t pages);
+        // Only forgets the mappings. Their pages are left in the page
+        // directory for the caller to clear
         void clear() noexcept;
 
         const Mapping& lookup(vaddr_t address) const;
@@ -44,10 +44,17 @@ class Page {
             return _resident.cap;
         }
 
+        // Only valid until the page is next swapped out
+        uint8_t* getWindowAddress() const;
+        // Also only valid until then. Null if the page isn't a frame from the
+        // frame table
+        const FrameTable::Frame* getFrame() const;
+
         explicit operator bool() const noexcept {return _status != Status::INVALID;}
 
     private:
         Page(FrameTable::Frame& frame);
+        Page(FrameTable::Frame& frame, seL4_ARM_Page cap);
         Page(paddr_t address);
 
         Page(const Page& other);
@@ -68,7 +75,7 @@ class Page {
         mutable Page* _next;
 
         friend void FrameTable::init(paddr_t start, paddr_t end);
-        friend async::future<Page> FrameTable::alloc();
+        friend async::future<Page> FrameTable::alloc(int nice);
         friend Page FrameTable::alloc(paddr_t address);
 
         friend class FrameTable::Frame;
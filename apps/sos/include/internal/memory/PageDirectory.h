@@ -1,5 +1,6 @@
 #pragma once
 
+#include <list>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -35,6 +36,9 @@ constexpr bool operator!=(const Attributes& a, const Attributes& b) {
 class PageTable;
 class MappedPage;
 
+// What it took to make a page resident
+enum class FaultType {MINOR, ZERO_FILL, SWAP_IN, FILE_FILL};
+
 class PageDirectory {
     public:
         PageDirectory() = default;
@@ -50,15 +54,23 @@ class PageDirectory {
         size_t countPages() const noexcept;
 
         void reservePages(vaddr_t from, vaddr_t to);
+        void reservePageTable(vaddr_t address);
 
         // Warning: Returned MappedPage reference is invalidated after another mapping
 
-        async::future<const MappedPage&> makeResident(vaddr_t address, Attributes attributes);
-        async::future<const MappedPage&> allocateAndMap(vaddr_t address, Attributes attributes);
+        // Faults on a page that's already being allocated or swapped in wait
+        // for that to finish and then look again, since ranges are faulted in
+        // concurrently. nice is that of the process faulting, and orders any
+        // swapping out this has to wait for
+        async::future<const MappedPage&> makeResident(vaddr_t address, Attributes attributes, FaultType* type = nullptr, int nice = 0);
+        async::future<const MappedPage&> allocateAndMap(vaddr_t address, Attributes attributes, int nice = 0);
 
         const MappedPage& map(Page page, vaddr_t address, Attributes attributes);
         void unmap(vaddr_t address) noexcept;
         void clear() noexcept;
+        // Unmaps at most `maxPages` pages, returning whether there are none
+        // left, so a large address space can be torn down a bit at a time
+        bool clearSome(size_t maxPages) noexcept;
 
         const MappedPage* lookup(vaddr_t address, bool noThrow = false) const;
 
@@ -69,8 +81,15 @@ class PageDirectory {
             return pageTableAlign(address);
         }
 
+        PageTable& _getTable(vaddr_t address);
+
+        async::future<const MappedPage&> _addPendingFault(vaddr_t address, async::future<const MappedPage&> fault);
+
         Capability<seL4_ARM_PageDirectoryObject, seL4_PageDirBits> _cap;
         std::unordered_map<vaddr_t, PageTable> _tables;
+
+        // Whoever is waiting on each page that's being faulted in
+        std::unordered_map<vaddr_t, std::list<async::promise<void>>> _pendingFaults;
 };
 
 class PageTable {
@@ -90,6 +109,8 @@ class PageTable {
 
         const MappedPage& map(Page page, vaddr_t address, Attributes attributes);
         void unmap(vaddr_t address) noexcept;
+        // Returns how many were unmapped
+        size_t clearSome(size_t maxPages) noexcept;
 
         MappedPage* lookup(vaddr_t address, bool noThrow = false);
         const MappedPage* lookup(vaddr_t address, bool noThrow = false) const;
@@ -121,7 +142,7 @@ class MappedPage {
         MappedPage& operator=(MappedPage&& other) = delete;
 
         void enableReference(PageDirectory& directory);
-        async::future<void> swapIn();
+        async::future<void> swapIn(int nice = 0);
 
         const Page& getPage() const noexcept {return _page;}
         vaddr_t getAddress() const noexcept {return _address;}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <functional>
+#include <list>
 #include <queue>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "internal/async.h"
@@ -19,8 +22,10 @@ class Swap {
     public:
         void addBackingStore(std::shared_ptr<fs::File> store, size_t size);
 
-        async::future<void> swapOut(FrameTable::Frame& frame);
-        async::future<void> swapIn(const Page& page);
+        // Swap outs are queued by the nice value of whoever needs the frame,
+        // lowest first
+        async::future<void> swapOut(FrameTable::Frame& frame, int nice);
+        async::future<void> swapIn(const Page& page, int nice = 0);
 
         void copy(const Page& from, Page& to) noexcept;
         void erase(Page& page) noexcept;
@@ -36,18 +41,33 @@ class Swap {
         SwapId _allocate();
         void _free(SwapId id) noexcept;
 
+        struct PendingSwapOut {
+            int nice;
+            size_t sequence; // So equal nice values go in order
+            std::function<void ()> start;
+
+            // std::priority_queue takes the greatest first
+            bool operator<(const PendingSwapOut& other) const noexcept {
+                return std::tie(nice, sequence) > std::tie(other.nice, other.sequence);
+            }
+        };
+
+        void _startNextSwapOut();
+        void _finishSwapOut();
+
         std::shared_ptr<fs::File> _store;
 
         std::vector<bool> _usedBitset;
         size_t _lastUsed = -1U;
 
-        std::queue<std::function<void ()>> _pendingSwapOuts;
+        std::priority_queue<PendingSwapOut> _pendingSwapOuts;
+        size_t _nextSequence = 0;
+        bool _isSwappingOut = false;
+
+        // Whoever is waiting on each swap slot that's being swapped in
+        std::unordered_map<SwapId, std::list<async::promise<void>>> _pendingSwapIns;
         const ScopedMapping _swapOutBufferMapping;
         const std::vector<fs::IoVector> _swapOutBufferIoVectors;
-
-        std::queue<std::function<void ()>> _pendingSwapIns;
-        const ScopedMapping _swapInBufferMapping;
-        const std::vector<fs::IoVector> _swapInBufferIoVectors;
 };
 
 }
@@ -5,7 +5,9 @@
 #include <type_traits>
 #include <utility>
 #include <vector>
+#include <limits.h>
 
+#include "internal/Future.h"
 #include "internal/async.h"
 #include "internal/memory/PageDirectory.h"
 #include "internal/process/Thread.h"
@@ -16,55 +18,85 @@ class UserMemory {
     public:
         UserMemory(std::weak_ptr<process::Process> process, vaddr_t address);
 
-        async::future<std::string> readString(bool bypassAttributes = false);
+        // The same process' memory, `offset` bytes further on
+        UserMemory operator+(size_t offset) const {return UserMemory(_process, _address + offset);}
+
+        // Reads a NUL terminated string of at most `size - 1` characters into
+        // `buffer`, returning its length. Fails with ENAMETOOLONG if longer
+        async::future<size_t> readString(char* buffer, size_t size, bool bypassAttributes = false);
+        async::future<std::string> readString(bool bypassAttributes = false, size_t maxLength = PATH_MAX - 1);
+
+        // These build their chains on async::Future, which doesn't allocate
+        // when the memory is already resident, and only convert to a
+        // boost::future at the end
+        template <typename T, typename = std::enable_if_t<std::is_pod<T>::value>>
+        async::future<void> read(T* begin, T* end, bool bypassAttributes = false) {
+            return _copy(
+                reinterpret_cast<uint8_t*>(begin), (end - begin) * sizeof(T),
+                false, false, bypassAttributes
+            ).then([](auto copied) {
+                (void)copied.get();
+            }).toBoostFuture();
+        }
 
         template <typename It, typename = std::enable_if_t<std::is_pod<typename std::iterator_traits<It>::value_type>::value>>
         async::future<void> read(It begin, It end, bool bypassAttributes = false) {
-            size_t length = end - begin;
-
-            return mapIn<typename std::iterator_traits<It>::value_type>(
-                length, Attributes{.read = true}, bypassAttributes
-            ).then([begin, length](auto map) {
-                auto map_ = std::move(map.get());
-                std::copy(map_.first, map_.first + length, begin);
-            });
+            // Not necessarily contiguous, so read into a temporary buffer first
+            auto buffer = std::make_shared<std::vector<typename std::iterator_traits<It>::value_type>>(end - begin);
+            return read(buffer->data(), buffer->data() + buffer->size(), bypassAttributes)
+                .then([begin, buffer](async::future<void> result) {
+                    result.get();
+                    std::copy(buffer->begin(), buffer->end(), begin);
+                });
+        }
+
+        template <typename T, typename = std::enable_if_t<std::is_pod<T>::value>>
+        async::future<void> write(T* begin, T* end, bool bypassAttributes = false) {
+            // Only read from when writing, so casting away the const is fine
+            return _copy(
+                const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(begin)), (end - begin) * sizeof(T),
+                true, false, bypassAttributes
+            ).then([](auto copied) {
+                (void)copied.get();
+            }).toBoostFuture();
         }
 
         template <typename It, typename = std::enable_if_t<std::is_pod<typename std::iterator_traits<It>::value_type>::value>>
         async::future<void> write(It begin, It end, bool bypassAttributes = false) {
-            size_t length = end - begin;
-
-            return mapIn<typename std::iterator_traits<It>::value_type>(
-                length, Attributes{.read = false, .write = true}, bypassAttributes
-            ).then([begin, end](auto map) {
-                auto map_ = std::move(map.get());
-                std::copy(begin, end, map_.first);
-            });
+            auto buffer = std::make_shared<std::vector<typename std::iterator_traits<It>::value_type>>(begin, end);
+            return write(buffer->data(), buffer->data() + buffer->size(), bypassAttributes)
+                .then([buffer](async::future<void> result) {
+                    result.get();
+                });
         }
 
         template <typename T>
         async::future<T> get(bool bypassAttributes = false) {
             auto out = std::make_shared<T>();
-            return read(out.get(), out.get() + 1, bypassAttributes)
-                .then([out](async::future<void> result) {
-                    result.get();
+            return _copy(reinterpret_cast<uint8_t*>(out.get()), sizeof(T), false, false, bypassAttributes)
+                .then([out](auto copied) {
+                    (void)copied.get();
                     return std::move(*out);
-                });
+                }).toBoostFuture();
         }
 
         template <typename T>
         async::future<std::vector<T>> get(size_t length, bool bypassAttributes = false) {
             auto out = std::make_shared<std::vector<T>>(length);
-            return read(out->begin(), out->end(), bypassAttributes)
-                .then([out](async::future<void> result) {
-                    result.get();
+            return _copy(reinterpret_cast<uint8_t*>(out->data()), length * sizeof(T), false, false, bypassAttributes)
+                .then([out](auto copied) {
+                    (void)copied.get();
                     return std::move(*out);
-                });
+                }).toBoostFuture();
         }
 
         template <typename T>
         async::future<void> set(const T& value, bool bypassAttributes = false) {
-            return write(&value, &value + 1, bypassAttributes);
+            auto in = std::make_shared<T>(value);
+            return _copy(reinterpret_cast<uint8_t*>(in.get()), sizeof(T), true, false, bypassAttributes)
+                .then([in](auto copied) {
+                    (void)copied.get();
+                }).toBoostFuture();
         }
 
         template <typename T>
@@ -79,6 +111,16 @@ class UserMemory {
     private:
         async::future<std::pair<uint8_t*, ScopedMapping>> _mapIn(size_t bytes, Attributes attributes, bool bypassAttributes);
 
+        // Returns where `address` can be accessed from SOS, or nullptr if the
+        // page needs to go through the page fault handler first
+        uint8_t* _tryTranslate(vaddr_t address, Attributes attributes, bool bypassAttributes) const;
+
+        // Copies everything starting from `copied` bytes in that can be done
+        // without blocking, returning how far it got. Strings stop after the
+        // NUL terminator
+        size_t _tryCopy(uint8_t* buffer, size_t bytes, size_t copied, bool isWrite, bool isString, bool bypassAttributes) const;
+        async::Future<size_t> _copy(uint8_t* buffer, size_t bytes, bool isWrite, bool isString, bool bypassAttributes, size_t copied = 0) const;
+
         std::weak_ptr<process::Process> _process;
         vaddr_t _address;
 };
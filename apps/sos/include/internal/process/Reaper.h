@@ -0,0 +1,44 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "internal/memory/Mappings.h"
+#include "internal/process/Thread.h"
+
+namespace process {
+
+// Tears down exited processes in the background, so freeing a large address
+// space doesn't hold up everything else. Each step runs from the run queue
+// and frees at most CONFIG_SOS_REAPER_BUDGET pages, then queues the next one
+class Reaper {
+    public:
+        // Takes over the process' file descriptors, mappings and pages. It
+        // must not have any threads left that could still be using them
+        void add(std::shared_ptr<Process> process);
+        // Takes over the pages of a mapping only an exited thread was using,
+        // such as its stack. The range stays reserved until they're all gone
+        void add(std::shared_ptr<Process> process, memory::ScopedMapping mapping);
+
+        static Reaper& get() noexcept;
+
+    private:
+        Reaper() = default;
+
+        struct Range {
+            std::weak_ptr<Process> process;
+            memory::vaddr_t start;
+            size_t pages;
+            size_t unmappedPages;
+        };
+
+        void _queueStep();
+        void _step() noexcept;
+        void _stepRange() noexcept;
+
+        std::deque<std::shared_ptr<Process>> _processes;
+        std::deque<Range> _ranges;
+        bool _isStepQueued = false;
+};
+
+}
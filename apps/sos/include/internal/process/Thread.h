@@ -6,6 +6,7 @@
 extern "C" {
     #include <cspace/cspace.h>
     #include <sel4/types.h>
+    #include <sos.h>
 }
 
 #include "internal/async.h"
@@ -15,14 +16,39 @@ extern "C" {
 #include "internal/timer/timer.h"
 #include "internal/Capability.h"
 
+namespace syscall {
+    class Ring;
+}
+
 namespace process {
 
+// Data passed directly in the IPC buffer by the inline syscalls. Each thread
+// reuses its own, since it only ever has one syscall in flight
+struct InlinePayload {
+    size_t length; // Of the reply, if there is one
+    uint8_t data[SOS_INLINE_MAX];
+};
+
+// How to answer a fault. The main loop sends replies that are ready straight
+// away along with its next wait
+struct Reply {
+    bool isReady;
+    seL4_MessageInfo_t message;
+    seL4_Word result; // MR 0, if the message has one
+    std::shared_ptr<const InlinePayload> payload; // From MR 1 onwards
+};
+
+// Like Linux' nice values, lower runs first
+constexpr const int MIN_NICE = -20;
+constexpr const int MAX_NICE = 19;
+
 class Thread;
 class Process : public std::enable_shared_from_this<Process> {
     public:
         static std::shared_ptr<Process> create(std::shared_ptr<Process> parent) {
             auto result = std::shared_ptr<Process>(new Process(parent));
             result->maps._process = result;
+            timer::mapTimePage(*result);
             parent->_children.insert(result);
             return result;
         }
@@ -40,15 +66,30 @@ class Process : public std::enable_shared_from_this<Process> {
         void onChildExit(const ChildExitCallback& callback);
         void emitChildExit(std::shared_ptr<Process> process) noexcept;
 
-        async::future<void> handlePageFault(memory::vaddr_t, memory::Attributes attributes);
+        const memory::Mapping& checkAccess(memory::vaddr_t address, memory::Attributes cause) const;
+        async::future<void> handlePageFault(memory::vaddr_t, memory::Attributes attributes, memory::FaultType* type = nullptr);
         async::future<void> pageFaultMultiple(memory::vaddr_t start, size_t pages, memory::Attributes attributes, std::shared_ptr<memory::ScopedMapping> map);
 
-        pid_t getPid() const noexcept;
+        // The first thread's ID, which stays reserved until the process has
+        // been waited on
+        pid_t getPid() const noexcept {return _pid;}
         bool isZombie() const noexcept {return _isZombie;}
 
+        // Kills every thread, and hence the process
+        void kill() noexcept;
+
+        // New processes start with their parent's nice value. Out of range
+        // values are clamped, like Linux does
+        int getNice() const noexcept {return _nice;}
+        void setNice(int nice) noexcept;
+
+        // Where to queue continuations that resume one of the threads
+        async::Executor& getReplyExecutor() const noexcept;
+
         memory::PageDirectory pageDirectory;
         memory::Mappings maps;
         fs::FDTable fdTable;
+        std::shared_ptr<syscall::Ring> ring;
 
         std::string filename;
 
@@ -60,19 +101,23 @@ class Process : public std::enable_shared_from_this<Process> {
         friend std::shared_ptr<Process> getSosProcess() noexcept;
 
         void _shrinkZombie() noexcept;
+        async::future<void> _fillPage(memory::vaddr_t address, memory::Attributes attributes, std::shared_ptr<const memory::Backing> backing, memory::FaultType* type);
+        void _mapFilledPage(memory::Page page, memory::vaddr_t address, memory::Attributes attributes);
 
+        pid_t _pid = 0;
+        int _nice = 0;
         bool _isZombie = false;
+        bool _isReaped = false;
 
         std::weak_ptr<Process> _parent;
         std::set<std::weak_ptr<Process>, std::owner_less<std::weak_ptr<Process>>> _children;
 
         std::set<std::weak_ptr<Thread>, std::owner_less<std::weak_ptr<Thread>>> _threads;
 
-        std::unique_ptr<cspace_t, std::function<void (cspace_t*)>> _cspace;
-
         std::list<ChildExitCallback> _childExitListeners;
 
         friend class Thread;
+        friend class Reaper;
 };
 
 class Thread : public std::enable_shared_from_this<Thread> {
@@ -81,8 +126,6 @@ class Thread : public std::enable_shared_from_this<Thread> {
         static std::shared_ptr<Thread> create(Args&& ...args) {
             auto result = std::shared_ptr<Thread>(new Thread(std::forward<Args>(args)...));
             result->_process->_threads.insert(result);
-            // TODO: Only supports single-threaded processes
-            assert(result->_process->_threads.size() == 1);
             return result;
         }
         ~Thread();
@@ -93,15 +136,29 @@ class Thread : public std::enable_shared_from_this<Thread> {
         Thread(Thread&& other) = delete;
         Thread& operator=(Thread&& other) = delete;
 
+        // Starts at `entryPoint` with `argument` in r0. The stack pointer
+        // defaults to the top of the thread's own stack. There's no thread
+        // pointer register, so `threadPointer` goes in the IPC buffer's user
+        // data word instead
         async::future<void> start(
             pid_t tid,
             const Capability<seL4_EndpointObject, seL4_EndpointBits>& faultEndpoint,
             seL4_Word faultEndpointBadge,
-            memory::vaddr_t entryPoint
+            memory::vaddr_t entryPoint,
+            memory::vaddr_t stackPointer = 0,
+            seL4_Word argument = 0,
+            seL4_Word threadPointer = 0
         );
+        // The process goes with its last thread
         void kill() noexcept;
 
-        void handleFault(const seL4_MessageInfo_t& message) noexcept;
+        // Where to write 0 when the thread exits, like CLONE_CHILD_CLEARTID
+        void setClearChildTid(memory::vaddr_t address) noexcept {_clearChildTid = address;}
+
+        Reply handleFault(const seL4_MessageInfo_t& message) noexcept;
+
+        // Applies the process' nice value to the seL4 thread
+        void updatePriority() noexcept;
 
         pid_t getTid() const noexcept {return _tid;}
         std::shared_ptr<Process> getProcess() noexcept {return _process;}
@@ -109,15 +166,25 @@ class Thread : public std::enable_shared_from_this<Thread> {
 
         timer::Timestamp getStartTime() const noexcept {return _startTime;}
 
+        std::shared_ptr<InlinePayload> getInlinePayload();
+
     private:
         explicit Thread(std::shared_ptr<Process> process);
 
+        Reply _getSyscallReply(long number, timer::Timestamp start, async::future<int> result) noexcept;
+
+        void _sendLater(seL4_CPtr replyCap, const Reply& reply) noexcept;
+        friend void sendDeferredReplies() noexcept;
+
         enum class Status {CREATED, STARTED, ZOMBIE};
         Status _status;
 
         pid_t _tid;
         std::shared_ptr<Process> _process;
 
+        // Each thread has its own CSpace, so its fault endpoint can be at
+        // SOS_IPC_EP_CAP with its own badge
+        std::unique_ptr<cspace_t, std::function<void (cspace_t*)>> _cspace;
         seL4_CPtr _faultEndpoint;
         Capability<seL4_TCBObject, seL4_TCBBits> _tcbCap;
 
@@ -125,8 +192,14 @@ class Thread : public std::enable_shared_from_this<Thread> {
         memory::ScopedMapping _ipcBuffer;
 
         timer::Timestamp _startTime;
+        memory::vaddr_t _clearChildTid = 0;
+
+        std::shared_ptr<InlinePayload> _inlinePayload;
 };
 
 std::shared_ptr<Process> getSosProcess() noexcept;
 
+void setReplyMRs(const Reply& reply) noexcept;
+void sendDeferredReplies() noexcept;
+
 }
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace selftest {
+
+/**
+ * Checks the behaviour of some of SOS' internals, panicking on the first
+ * check that fails.
+ */
+void run() noexcept;
+
+}
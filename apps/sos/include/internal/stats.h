@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "internal/timer/timer.h"
+
+namespace memory {
+    enum class FaultType;
+}
+
+namespace stats {
+
+constexpr const size_t LATENCY_BUCKETS = 24;
+
+struct Counter {
+    uint64_t count;
+    uint64_t errors;
+
+    // Bucket n counts latencies under 2^n microseconds that didn't fit in
+    // bucket n - 1. The last bucket also takes anything longer
+    std::array<uint32_t, LATENCY_BUCKETS> histogram;
+
+    void record(timer::Duration latency, bool isError) noexcept;
+};
+
+// Latency is from when SOS starts handling the syscall or fault to when it
+// has the reply ready
+void recordSyscall(long number, timer::Duration latency, bool isError) noexcept;
+void recordFault(memory::FaultType type, timer::Duration latency, bool isError) noexcept;
+
+// One line for everything that has happened at least once, in the form
+//   <name> count <n> errors <n> latency <bucket>:<n> <bucket>:<n> ...
+// where only non-empty buckets are listed
+std::string format();
+
+}
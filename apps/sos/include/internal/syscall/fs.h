@@ -10,6 +10,12 @@ async::future<int> stat64(std::weak_ptr<process::Process> process, memory::vaddr
 async::future<int> open(std::weak_ptr<process::Process> process, memory::vaddr_t pathname, int flags, mode_t mode);
 async::future<int> close(std::weak_ptr<process::Process> process, int fd);
 
+async::future<int> pipe(std::weak_ptr<process::Process> process, memory::vaddr_t pipefd);
+async::future<int> pipe2(std::weak_ptr<process::Process> process, memory::vaddr_t pipefd, int flags);
+async::future<int> dup(std::weak_ptr<process::Process> process, int oldFd);
+async::future<int> dup2(std::weak_ptr<process::Process> process, int oldFd, int newFd);
+async::future<int> dup3(std::weak_ptr<process::Process> process, int oldFd, int newFd, int flags);
+
 async::future<int> read(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t buf, size_t count);
 async::future<int> readv(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t iov, size_t iovcnt);
 async::future<int> pread(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t buf, size_t count, off64_t offset);
@@ -20,8 +26,18 @@ async::future<int> writev(std::weak_ptr<process::Process> process, int fd, memor
 async::future<int> pwrite(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t buf, size_t count, off64_t offset);
 async::future<int> pwritev(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t iov, size_t iovcnt, off64_t offset);
 
+async::future<int> sendfile64(std::weak_ptr<process::Process> process, int outFd, int inFd, memory::vaddr_t offset, size_t count);
+async::future<int> copy_file_range(std::weak_ptr<process::Process> process, int inFd, memory::vaddr_t inOffset, int outFd, memory::vaddr_t outOffset, size_t count, unsigned int flags);
+
 async::future<int> getdents64(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t dirp, size_t count);
 
+// These take their payload from the IPC buffer after the arguments, and reply
+// with one there too if needed
+async::future<int> sos_inline_stat64(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv);
+async::future<int> sos_inline_open(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv);
+async::future<int> sos_inline_read(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv);
+async::future<int> sos_inline_write(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv);
+
 async::future<int> fcntl64(std::weak_ptr<process::Process> process, int fd, int cmd, int arg);
 async::future<int> ioctl(std::weak_ptr<process::Process> process, int fd, size_t request, memory::vaddr_t argp);
 
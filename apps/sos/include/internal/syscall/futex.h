@@ -0,0 +1,18 @@
+#pragma once
+
+#include "internal/syscall/syscall.h"
+
+namespace syscall {
+
+// Only FUTEX_WAIT (with an optional relative timeout) and FUTEX_WAKE
+async::future<int> futex(std::weak_ptr<process::Thread> thread, memory::vaddr_t address, int op, int value, memory::vaddr_t timeout);
+
+// Wakes at most `count` threads waiting on the futex at `address`, returning
+// how many were woken
+int wakeFutex(const process::Process& process, memory::vaddr_t address, int count);
+
+// Drops whatever the thread (or any other dead thread) is waiting on, along
+// with the page it was keeping mapped in
+void cancelFutexWaits(const process::Thread& thread) noexcept;
+
+}
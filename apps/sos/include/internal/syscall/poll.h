@@ -0,0 +1,16 @@
+#pragma once
+
+#include <poll.h>
+
+#include "internal/syscall/syscall.h"
+
+namespace syscall {
+
+async::future<int> poll(std::weak_ptr<process::Process> process, memory::vaddr_t fds, nfds_t nfds, int timeout);
+
+async::future<int> epoll_create(std::weak_ptr<process::Process> process, int size);
+async::future<int> epoll_create1(std::weak_ptr<process::Process> process, int flags);
+async::future<int> epoll_ctl(std::weak_ptr<process::Process> process, int epfd, int op, int fd, memory::vaddr_t event);
+async::future<int> epoll_wait(std::weak_ptr<process::Process> process, int epfd, memory::vaddr_t events, int maxevents, int timeout);
+
+}
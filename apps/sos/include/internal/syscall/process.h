@@ -16,6 +16,11 @@ async::future<int> kill(std::weak_ptr<process::Process> process, pid_t pid, int
 
 async::future<int> exit_group(std::weak_ptr<process::Process> process, int status);
 
+// Only PRIO_PROCESS, which sets the nice value of every thread in the process
+async::future<int> getpriority(std::weak_ptr<process::Process> process, int which, id_t who);
+async::future<int> setpriority(std::weak_ptr<process::Process> process, int which, id_t who, int prio);
+async::future<int> nice(std::weak_ptr<process::Process> process, int increment);
+
 async::future<pid_t> process_create(std::weak_ptr<process::Process> process, memory::vaddr_t filename);
 
 async::future<int> sos_process_status(std::weak_ptr<process::Process> process, memory::vaddr_t processes, unsigned max);
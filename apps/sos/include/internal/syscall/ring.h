@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+
+extern "C" {
+    #include <sos.h>
+}
+
+#include "internal/memory/Mappings.h"
+#include "internal/syscall/syscall.h"
+
+namespace syscall {
+
+// A process' submission and completion rings, as seen from SOS
+class Ring : public std::enable_shared_from_this<Ring> {
+    public:
+        Ring(sos_ring_t* shared, memory::ScopedMapping mapping) noexcept;
+
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        // Starts everything submitted so far, then has the thread wait for
+        // at least `minComplete` completions
+        async::future<int> enter(std::weak_ptr<process::Thread> thread, unsigned minComplete);
+
+        // Drops the thread's wait, if it's the one waiting
+        void cancelWait(const process::Thread& thread) noexcept;
+
+    private:
+        void _start(std::weak_ptr<process::Process> process, sos_ring_sqe_t sqe);
+        void _complete(seL4_Word userData, int result) noexcept;
+
+        // Completions the process hasn't taken yet
+        uint32_t _getCompleted() const noexcept;
+
+        sos_ring_t* _shared;
+        memory::ScopedMapping _mapping;
+
+        // Our own copies of the indices we own, since the process can write
+        // to the shared ones
+        uint32_t _sqHead = 0;
+        uint32_t _cqTail = 0;
+
+        uint32_t _inFlight = 0;
+
+        std::unique_ptr<async::promise<int>> _waiter;
+        std::weak_ptr<process::Thread> _waiterThread;
+        unsigned _waiterMinComplete;
+};
+
+async::future<int> sos_ring_setup(std::weak_ptr<process::Process> process);
+async::future<int> sos_ring_enter(std::weak_ptr<process::Thread> thread, unsigned minComplete);
+
+// Drops the thread's wait on its process' rings, so they don't stay busy
+// after it dies
+void cancelRingWait(process::Thread& thread) noexcept;
+
+}
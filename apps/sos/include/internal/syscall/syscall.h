@@ -28,6 +28,8 @@ int exceptionToErrno(std::exception_ptr e) noexcept;
             argv[a] = va_arg(ap, seL4_Word);                                                 \
         _Pragma("GCC diagnostic pop");                                                       \
                                                                                              \
+        /* Our own syscalls have nothing to wait on, so must complete now */                 \
+        async::RunQueue::Inline inlineContinuations;                                         \
         try {                                                                                \
             auto result = syscall::handle(process::getSosProcess(), SYS_##name, argc, argv); \
             assert(result.is_ready());                                                       \
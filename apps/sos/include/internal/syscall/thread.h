@@ -6,7 +6,13 @@
 
 namespace syscall {
 
+// Like Linux' clone(), except the new thread doesn't return from it. It starts
+// at `entryPoint` instead, with `stack` in r0 as well as sp so it can find
+// what the caller left there for it
+async::future<pid_t> clone(std::weak_ptr<process::Thread> thread, int flags, memory::vaddr_t stack, memory::vaddr_t parentTid, seL4_Word threadPointer, memory::vaddr_t childTid, memory::vaddr_t entryPoint);
+
 async::future<pid_t> gettid(std::weak_ptr<process::Thread> thread);
+async::future<pid_t> set_tid_address(std::weak_ptr<process::Thread> thread, memory::vaddr_t address);
 
 async::future<int> tkill(std::weak_ptr<process::Process> process, pid_t tid, int signal);
 async::future<int> tgkill(std::weak_ptr<process::Process> process, pid_t tgid, pid_t tid, int signal);
@@ -2,6 +2,7 @@
 
 extern "C" {
     #include <sel4/types.h>
+    #include <sos.h>
 }
 
 #include "internal/memory/DeviceMemory.h"
@@ -31,6 +32,13 @@ class Hardware {
         // Call this when a clock interrupt is received
         void handleIrq() noexcept;
 
+        // The register page, for mapping read-only into processes
+        memory::vaddr_t getRegistersAddress() const noexcept {return _registers.getAddress();}
+
+        // Fills in everything but the sequence number, for processes to read
+        // the time from the registers themselves
+        void describe(sos_time_page_t& page) const noexcept;
+
     private:
         struct Registers;
         memory::DeviceMemory<Registers> _registers;
@@ -10,6 +10,10 @@ extern "C" {
 
 #include "internal/Capability.h"
 
+namespace process {
+    class Process;
+}
+
 namespace timer {
 
 struct clock {
@@ -67,4 +71,10 @@ void clearTimer(TimerId id);
  */
 void handleIrq() noexcept;
 
+/**
+ * Map the shared time page read-only into a process at SOS_TIME_PAGE, so it
+ * can read the time without a syscall
+ */
+void mapTimePage(process::Process& process);
+
 }
@@ -13,11 +13,19 @@
 #define _BITFIELD_H_
 
 
+#include <stdint.h>
+
+/*
+ * Bits are stored 32 to a word. Each word also has a bit in the summary level
+ * which is set when the word is completely full, so a search can skip over
+ * 32 full words at a time.
+ */
 typedef struct {
     int next_free;
     int available;
     int size;
-    char* b;
+    uint32_t* w;
+    uint32_t* summary;
 } bitfield_t;
 
 enum bf_init_state {
@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "internal/ObjectCache.h"
+
+bool SlotCache::copy(seL4_CPtr cap, size_t n, seL4_CPtr* copies) noexcept {
+    if (!_take(n, copies))
+        return false;
+
+    for (size_t i = 0; i < n; ++i) {
+        seL4_Error err = seL4_CNode_Copy(
+            cur_cspace->root_cnode, copies[i], CSPACE_DEPTH,
+            cur_cspace->root_cnode, cap, CSPACE_DEPTH,
+            seL4_AllRights
+        );
+        if (err != seL4_NoError) {
+            remove(i, copies);
+            _give(n - i, copies + i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SlotCache::remove(size_t n, const seL4_CPtr* caps) noexcept {
+    for (size_t i = 0; i < n; ++i)
+        assert(seL4_CNode_Delete(cur_cspace->root_cnode, caps[i], CSPACE_DEPTH) == seL4_NoError);
+    _give(n, caps);
+}
+
+void SlotCache::refill() noexcept {
+    if (_count >= CAPACITY / 2)
+        return;
+
+    size_t n = CAPACITY / 2 - _count;
+    if (cspace_alloc_slots(cur_cspace, n, &_slots[_count]) == CSPACE_NOERROR)
+        _count += n;
+}
+
+bool SlotCache::_take(size_t n, seL4_CPtr* slots) noexcept {
+    if (n > CAPACITY)
+        return cspace_alloc_slots(cur_cspace, n, slots) == CSPACE_NOERROR;
+
+    if (_count < n) {
+        // Get what's missing, and a batch more for next time
+        size_t more = std::min(CAPACITY - _count, n - _count + BATCH);
+        if (cspace_alloc_slots(cur_cspace, more, &_slots[_count]) != CSPACE_NOERROR)
+            return false;
+        _count += more;
+    }
+
+    _count -= n;
+    std::copy(&_slots[_count], &_slots[_count] + n, slots);
+    return true;
+}
+
+void SlotCache::_give(size_t n, const seL4_CPtr* slots) noexcept {
+    size_t kept = std::min(n, CAPACITY - _count);
+    std::copy(slots, slots + kept, &_slots[_count]);
+    _count += kept;
+
+    if (kept < n) {
+        // Full, so hand a batch back along with the rest
+        size_t spare = std::min(_count, BATCH);
+        _count -= spare;
+        cspace_free_slots(cur_cspace, spare, &_slots[_count]);
+        cspace_free_slots(cur_cspace, n - kept, slots + kept);
+    }
+}
+
+void refillObjectCaches() noexcept {
+    ObjectCache<seL4_ARM_SmallPageObject, seL4_PageBits>::get().refill();
+    ObjectCache<seL4_ARM_PageTableObject, seL4_PageTableBits>::get().refill();
+    ObjectCache<seL4_TCBObject, seL4_TCBBits>::get().refill();
+    ObjectCache<seL4_EndpointObject, seL4_EndpointBits>::get().refill();
+    SlotCache::get().refill();
+}
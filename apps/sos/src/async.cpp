@@ -2,6 +2,64 @@
 
 namespace async {
 
-boost::inline_executor asyncExecutor;
+Executor asyncExecutor(RunQueue::Priority::NORMAL);
+Executor urgentReplyExecutor(RunQueue::Priority::URGENT_REPLY);
+Executor replyExecutor(RunQueue::Priority::REPLY);
+Executor niceReplyExecutor(RunQueue::Priority::NICE_REPLY);
+Executor backgroundExecutor(RunQueue::Priority::BACKGROUND);
+
+RunQueue& RunQueue::get() noexcept {
+    static RunQueue runQueue;
+    return runQueue;
+}
+
+void RunQueue::post(Priority priority, std::function<void ()> f) {
+    _queues[static_cast<size_t>(priority)].push(std::move(f));
+}
+
+size_t RunQueue::run(size_t budget) {
+    size_t ran = 0;
+    while (ran < budget) {
+        // Look again each time, since whatever just ran might have posted
+        // something more important
+        auto queue = std::find_if(std::begin(_queues), std::end(_queues), [](const auto& queue) {
+            return !queue.empty();
+        });
+        if (queue == std::end(_queues))
+            break;
+
+        auto f = std::move(queue->front());
+        queue->pop();
+        f();
+        ++ran;
+    }
+    return ran;
+}
+
+bool RunQueue::isEmpty() const noexcept {
+    return std::all_of(std::begin(_queues), std::end(_queues), [](const auto& queue) {
+        return queue.empty();
+    });
+}
+
+RunQueue::Deferral::Deferral() noexcept:
+    _wasDeferring(RunQueue::get()._isDeferring)
+{
+    RunQueue::get()._isDeferring = true;
+}
+
+RunQueue::Deferral::~Deferral() {
+    RunQueue::get()._isDeferring = _wasDeferring;
+}
+
+RunQueue::Inline::Inline() noexcept:
+    _wasDeferring(RunQueue::get()._isDeferring)
+{
+    RunQueue::get()._isDeferring = false;
+}
+
+RunQueue::Inline::~Inline() {
+    RunQueue::get()._isDeferring = _wasDeferring;
+}
 
 }
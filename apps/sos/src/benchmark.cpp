@@ -0,0 +1,184 @@
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+
+extern "C" {
+    #include <autoconf.h>
+    #include <sel4/types.h>
+
+    #include "internal/sys/debug.h"
+    #include "internal/ut_manager/ut.h"
+}
+
+#include "internal/Future.h"
+#include "internal/benchmark.h"
+#include "internal/async.h"
+#include "internal/memory/UserMemory.h"
+#include "internal/process/Thread.h"
+#include "internal/syscall/syscall.h"
+#include "internal/timer/timer.h"
+
+namespace {
+    size_t _allocations = 0;
+}
+
+#ifdef CONFIG_SOS_BENCHMARK
+// Count every heap allocation so the benchmarks can report allocations per
+// operation
+void* operator new(size_t size) {
+    ++_allocations;
+    void* result = malloc(size == 0 ? 1 : size);
+    if (!result)
+        throw std::bad_alloc();
+    return result;
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t /*size*/) noexcept {
+    free(pointer);
+}
+#endif
+
+namespace benchmark {
+
+namespace {
+    template <typename F>
+    void _measure(const char* name, size_t iterations, F f) {
+        timer::Timestamp start = timer::getTimestamp();
+        for (size_t n = 0; n < iterations; ++n)
+            f();
+        timer::Duration elapsed = timer::getTimestamp() - start;
+
+        unsigned long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        kprintf(LOGLEVEL_NOTICE, "%-40s %8llu ns/op\n", name, nanoseconds / iterations);
+    }
+
+    template <typename F>
+    void _measureAllocations(const char* name, size_t iterations, F f) {
+        // Warm up any caches first so only the steady state is counted
+        f();
+
+        size_t start = _allocations;
+        for (size_t n = 0; n < iterations; ++n)
+            f();
+        size_t allocations = _allocations - start;
+
+        kprintf(LOGLEVEL_NOTICE, "%-40s %8u allocs/op (%u/%u)\n", name, allocations / iterations, allocations, iterations);
+    }
+
+    constexpr size_t ITERATIONS = 10000;
+
+    void _utAllocator() {
+        // Freeing then reallocating the same size should be served by the
+        // magazine
+        _measure("ut_alloc+ut_free frame", ITERATIONS, [] {
+            seL4_Word address = ut_alloc(seL4_PageBits);
+            assert(address);
+            ut_free(address, seL4_PageBits);
+        });
+        _measure("ut_alloc+ut_free page table", ITERATIONS, [] {
+            seL4_Word address = ut_alloc(seL4_PageTableBits);
+            assert(address);
+            ut_free(address, seL4_PageTableBits);
+        });
+
+        // Allocating more than fits in the magazine goes to the bitfields
+        constexpr size_t BATCH = 256;
+        std::vector<seL4_Word> addresses(BATCH);
+        _measure("ut_alloc+ut_free 256 frames", ITERATIONS / BATCH, [&addresses] {
+            for (auto& address : addresses) {
+                address = ut_alloc(seL4_PageBits);
+                assert(address);
+            }
+            for (auto address : addresses)
+                ut_free(address, seL4_PageBits);
+        });
+    }
+
+    void _futures() {
+        // A syscall that completes immediately
+        _measureAllocations("syscall getpid", ITERATIONS, [] {
+            seL4_Word argv[1] = {0};
+            auto result = syscall::handle(process::getSosProcess(), SYS_getpid, 0, argv);
+            assert(result.is_ready());
+            result.get();
+        });
+
+        // Copying in an argument that's already resident, which every syscall
+        // with a pointer argument does first
+        _measureAllocations("UserMemory::get ready", ITERATIONS, [] {
+            static int value = 1;
+            auto result = memory::UserMemory(
+                process::getSosProcess(), reinterpret_cast<memory::vaddr_t>(&value)
+            ).get<int>();
+            assert(result.is_ready());
+            result.get();
+        });
+
+        // The usual shape of a syscall: copy in, then work out the result
+        _measureAllocations("boost::future ready then", ITERATIONS, [] {
+            auto result = async::make_ready_future(static_cast<size_t>(1)).then([](async::future<size_t> copied) {
+                return static_cast<int>(copied.get());
+            });
+            assert(result.is_ready());
+            result.get();
+        });
+        _measureAllocations("async::Future ready then", ITERATIONS, [] {
+            auto result = async::makeReadyFuture(static_cast<size_t>(1)).then([](async::Future<size_t> copied) {
+                return static_cast<int>(copied.get());
+            });
+            assert(result.is_ready());
+            result.get();
+        });
+
+        // ... and when the copy in had to wait for a page fault
+        _measureAllocations("boost::future pending then", ITERATIONS, [] {
+            async::promise<size_t> promise;
+            auto result = promise.get_future().then([](async::future<size_t> copied) {
+                return static_cast<int>(copied.get());
+            });
+            promise.set_value(1);
+            result.get();
+        });
+        _measureAllocations("async::Future pending then", ITERATIONS, [] {
+            async::Promise<size_t> promise;
+            auto result = promise.get_future().then([](async::Future<size_t> copied) {
+                return static_cast<int>(copied.get());
+            });
+            promise.set_value(1);
+            result.get();
+        });
+
+        _measure("boost::future pending then", ITERATIONS, [] {
+            async::promise<size_t> promise;
+            auto result = promise.get_future().then([](async::future<size_t> copied) {
+                return static_cast<int>(copied.get());
+            });
+            promise.set_value(1);
+            result.get();
+        });
+        _measure("async::Future pending then", ITERATIONS, [] {
+            async::Promise<size_t> promise;
+            auto result = promise.get_future().then([](async::Future<size_t> copied) {
+                return static_cast<int>(copied.get());
+            });
+            promise.set_value(1);
+            result.get();
+        });
+    }
+}
+
+void run() noexcept {
+    kprintf(LOGLEVEL_NOTICE, "Running microbenchmarks...\n");
+    _utAllocator();
+    _futures();
+}
+
+}
@@ -1,31 +1,223 @@
+#include <algorithm>
+#include <list>
+#include <map>
 #include <stdexcept>
+#include <system_error>
 #include <stdint.h>
 
 #include "internal/elf.h"
+#include "internal/fs/File.h"
 #include "internal/memory/Mappings.h"
 #include "internal/memory/PageDirectory.h"
 #include "internal/memory/UserMemory.h"
 
 extern "C" {
+    #include <cpio/cpio.h>
     #include <elf/elf.h>
     #include <sel4/types.h>
 }
 
+extern char _cpio_archive[];
+
 namespace elf {
 
-async::future<memory::vaddr_t> load(std::shared_ptr<process::Process> process, uint8_t* file) {
+namespace {
+    // Images are only read into SOS' heap if they're smaller than this
+    constexpr const size_t MAX_IMAGE_SIZE = 16 * 1024 * 1024;
+    // Least recently used images are dropped from the cache past this
+    constexpr const size_t MAX_CACHE_SIZE = 8 * 1024 * 1024;
+
+    struct CachedImage {
+        std::string pathname;
+        timespec mtime;
+        Image image;
+        size_t size;
+    };
+    std::list<CachedImage> _cache; // Most recently used first
+    size_t _cacheSize;
+
+    Image _findCached(const std::string& pathname, const struct stat& stat) {
+        auto cached = std::find_if(_cache.begin(), _cache.end(), [&](const auto& cached) {
+            return cached.pathname == pathname;
+        });
+        if (cached == _cache.end())
+            return nullptr;
+
+        if (cached->mtime.tv_sec != stat.st_mtim.tv_sec || cached->mtime.tv_nsec != stat.st_mtim.tv_nsec) {
+            _cacheSize -= cached->size;
+            _cache.erase(cached);
+            return nullptr;
+        }
+
+        _cache.splice(_cache.begin(), _cache, cached);
+        return cached->image;
+    }
+
+    void _addCached(const std::string& pathname, const struct stat& stat, Image image, size_t size) {
+        if (size > MAX_CACHE_SIZE)
+            return;
+
+        // Another process might have loaded the same file at the same time
+        _findCached(pathname, stat);
+        if (!_cache.empty() && _cache.front().pathname == pathname)
+            return;
+
+        _cache.push_front(CachedImage{pathname, stat.st_mtim, std::move(image), size});
+        _cacheSize += size;
+        while (_cacheSize > MAX_CACHE_SIZE) {
+            _cacheSize -= _cache.back().size;
+            _cache.pop_back();
+        }
+    }
+
+    // Read-only segments of every image that's currently loaded, so another
+    // process loading the same one can share their pages. Keyed by where the
+    // segment is in the image, and where it goes
+    std::map<std::pair<const uint8_t*, memory::vaddr_t>, std::weak_ptr<const memory::Backing>> _sharedBackings;
+
+    std::shared_ptr<const memory::Backing> _getSharedBacking(Image image, const uint8_t* data, memory::vaddr_t start, size_t size) {
+        auto key = std::make_pair(data, start);
+        auto shared = _sharedBackings.find(key);
+        if (shared != _sharedBackings.end()) {
+            auto backing = shared->second.lock();
+            if (backing && backing->size == size)
+                return backing;
+        }
+
+        // The backing keeps the image alive, so nothing else can be loaded
+        // at the same address until the entry has expired
+        for (auto it = _sharedBackings.begin(); it != _sharedBackings.end();) {
+            if (it->second.expired())
+                it = _sharedBackings.erase(it);
+            else
+                ++it;
+        }
+
+        auto backing = std::make_shared<const memory::Backing>(memory::Backing{
+            .data = std::shared_ptr<const uint8_t>(image, data),
+            .start = start,
+            .size = size,
+            .sharedPages = std::make_shared<std::unordered_map<memory::vaddr_t, memory::Page>>()
+        });
+        _sharedBackings[key] = backing;
+        return backing;
+    }
+
+    async::future<void> _readFully(std::shared_ptr<fs::File> file, uint8_t* buffer, off64_t offset, size_t length) {
+        if (length == 0)
+            return async::make_ready_future();
+
+        return file->read({fs::IoVector{
+            .buffer = memory::UserMemory(process::getSosProcess(), reinterpret_cast<memory::vaddr_t>(buffer)),
+            .length = length
+        }}, offset).then([=](auto read) {
+            ssize_t _read = read.get();
+            if (_read == 0)
+                throw std::system_error(ENOEXEC, std::system_category(), "Executable is truncated");
+
+            return _readFully(file, buffer + _read, offset + _read, length - _read);
+        }).unwrap();
+    }
+
+    // Reads the headers, and then only the parts of the file the loadable
+    // segments need
+    async::future<std::pair<Image, size_t>> _readImage(std::shared_ptr<fs::File> file, size_t fileSize) {
+        auto header = std::make_shared<Elf32_Header>();
+        return _readFully(file, reinterpret_cast<uint8_t*>(header.get()), 0, sizeof(*header)).then([=](async::future<void> result) {
+            result.get();
+            if (elf_checkFile(header.get()))
+                throw std::system_error(ENOEXEC, std::system_category(), "Invalid ELF file");
+            if (header->e_phentsize != sizeof(Elf32_Phdr))
+                throw std::system_error(ENOEXEC, std::system_category(), "Invalid program header size");
+
+            size_t headersEnd = header->e_phoff + header->e_phnum * sizeof(Elf32_Phdr);
+            if (headersEnd > fileSize)
+                throw std::system_error(ENOEXEC, std::system_category(), "Executable is truncated");
+
+            auto programHeaders = std::make_shared<std::vector<Elf32_Phdr>>(header->e_phnum);
+            return _readFully(
+                file, reinterpret_cast<uint8_t*>(programHeaders->data()),
+                header->e_phoff, programHeaders->size() * sizeof(Elf32_Phdr)
+            ).then([=](async::future<void> result) {
+                result.get();
+
+                size_t size = std::max<size_t>(headersEnd, sizeof(*header));
+                for (const auto& programHeader : *programHeaders) {
+                    if (programHeader.p_type != PT_LOAD)
+                        continue;
+
+                    size_t end = programHeader.p_offset + programHeader.p_filesz;
+                    if (end < programHeader.p_offset || end > fileSize)
+                        throw std::system_error(ENOEXEC, std::system_category(), "Segment outside of the executable");
+                    size = std::max(size, end);
+                }
+                if (size > MAX_IMAGE_SIZE)
+                    throw std::system_error(ENOMEM, std::system_category(), "Executable is too big");
+
+                Image image(new uint8_t[size](), std::default_delete<uint8_t[]>());
+                std::copy_n(reinterpret_cast<uint8_t*>(header.get()), sizeof(*header), image.get());
+                std::copy_n(reinterpret_cast<uint8_t*>(programHeaders->data()), programHeaders->size() * sizeof(Elf32_Phdr), image.get() + header->e_phoff);
+
+                // All the segments are read at the same time
+                std::vector<async::future<void>> reads;
+                for (const auto& programHeader : *programHeaders) {
+                    if (programHeader.p_type == PT_LOAD)
+                        reads.push_back(_readFully(file, image.get() + programHeader.p_offset, programHeader.p_offset, programHeader.p_filesz));
+                }
+
+                return async::when_all(reads.begin(), reads.end()).then([image, size](auto results) {
+                    for (auto& result : results.get())
+                        result.get();
+
+                    return std::make_pair(image, size);
+                });
+            }).unwrap();
+        }).unwrap();
+    }
+}
+
+async::future<Image> open(const std::string& pathname) {
+    unsigned long size;
+    uint8_t* file = static_cast<uint8_t*>(cpio_get_file(_cpio_archive, pathname.c_str(), &size));
+    if (file) {
+        // Part of SOS, so it's never freed
+        return async::make_ready_future(Image(file, [](uint8_t*) {}));
+    }
+
+    return fs::rootFileSystem->stat(pathname).then([pathname](auto stat) {
+        auto _stat = stat.get();
+        if (!S_ISREG(_stat.st_mode))
+            throw std::system_error(EACCES, std::system_category(), "Not a regular file");
+        if (!(_stat.st_mode & S_IXUSR))
+            throw std::system_error(EACCES, std::system_category(), "Not executable");
+
+        if (auto image = _findCached(pathname, _stat))
+            return async::make_ready_future(image);
+
+        return fs::rootFileSystem->open(pathname, fs::FileSystem::OpenFlags{.read = true}).then([pathname, _stat](auto file) {
+            return _readImage(file.get(), _stat.st_size);
+        }).unwrap().then([pathname, _stat](auto image) {
+            auto _image = image.get();
+            _addCached(pathname, _stat, _image.first, _image.second);
+            return _image.first;
+        });
+    }).unwrap();
+}
+
+async::future<memory::vaddr_t> load(std::shared_ptr<process::Process> process, Image image) {
+    uint8_t* file = image.get();
     if (elf_checkFile(file))
         throw std::invalid_argument("Invalid ELF file");
 
-    std::vector<std::shared_ptr<memory::ScopedMapping>> maps;
-    std::vector<async::future<void>> writes;
+    // Nothing is copied in yet: each page is filled in from the image when
+    // it's first faulted in, so starting doesn't depend on the binary's size
+    std::vector<memory::ScopedMapping> maps;
 
     size_t headers = elf_getNumProgramHeaders(file);
     for (size_t h = 0; h < headers; ++h) {
         if (elf_getProgramHeaderType(file, h) != PT_LOAD)
             continue;
 
-        uint8_t* from = file + elf_getProgramHeaderOffset(file, h);
         memory::vaddr_t to = elf_getProgramHeaderVaddr(file, h);
         size_t fileSize = elf_getProgramHeaderFileSize(file, h);
         size_t memorySize = elf_getProgramHeaderMemorySize(file, h);
@@ -38,45 +230,36 @@ async::future<memory::vaddr_t> load(std::shared_ptr<process::Process> process, u
         memory::vaddr_t start = to - startPadding;
         size_t pages = memory::numPages(memorySize + startPadding);
 
-        auto map = std::make_shared<memory::ScopedMapping>(process->maps.insert(
+        // Pages that can't be written to are the same in every process
+        // loading this image, so they share one frame each
+        std::shared_ptr<const memory::Backing> backing;
+        const uint8_t* data = file + elf_getProgramHeaderOffset(file, h);
+        if (!(flags & PF_W)) {
+            backing = _getSharedBacking(image, data, to, fileSize);
+        } else if (fileSize > 0) {
+            backing = std::make_shared<memory::Backing>(memory::Backing{
+                .data = std::shared_ptr<const uint8_t>(image, data),
+                .start = to,
+                .size = fileSize
+            });
+        }
+
+        maps.push_back(process->maps.insert(
             start, pages,
             memory::Attributes{
                 .read = flags & PF_R,
                 .write = flags & PF_W,
                 .execute = flags & PF_X
             },
-            memory::Mapping::Flags{.shared = false, .fixed = true}
+            memory::Mapping::Flags{.shared = false, .fixed = true},
+            std::move(backing)
         ));
-
-        if (fileSize > 0) {
-            writes.push_back(
-                memory::UserMemory(process, to).write(from, from + fileSize, true)
-                    .then([process, map, startPadding, fileSize](async::future<void> result) {
-                        result.get();
-
-                        // Unify the data and instruction cache's view of the pages
-                        for (size_t b = 0; b < fileSize + startPadding; b += PAGE_SIZE) {
-                            assert(seL4_ARM_Page_Unify_Instruction(
-                                process->pageDirectory.lookup(map->getStart() + b)->getPage().getCap(),
-                                0, PAGE_SIZE
-                            ) == seL4_NoError);
-                        }
-                    })
-            );
-        }
-
-        maps.push_back(std::move(map));
     }
 
-    return async::when_all(writes.begin(), writes.end()).then([maps, file](auto results) {
-        for (auto& result : results.get())
-            result.get();
-
-        for (auto& map : maps)
-            map->release();
+    for (auto& map : maps)
+        map.release();
 
-        return static_cast<memory::vaddr_t>(elf_getEntryPoint(file));
-    });
+    return async::make_ready_future(static_cast<memory::vaddr_t>(elf_getEntryPoint(file)));
 }
 
 }
@@ -28,6 +28,7 @@ namespace {
         boost::circular_buffer_space_optimized<char>::capacity_type(MAX_BUFFER_SIZE, MIN_BUFFER_SIZE)
     );
     std::queue<std::pair<IoVector, async::promise<ssize_t>>> _readRequests;
+    ReadinessWaiters _readinessWaiters;
 
     void _tryRead(decltype(_readBuffer)::iterator newlinePos) noexcept {
         // TODO: Better mutual exclusion
@@ -92,6 +93,8 @@ namespace {
             _readBuffer.push_back(c);
             if (!_readRequests.empty())
                 _tryRead(_readBuffer.end() - (c == '\n' ? 1 : 0));
+            if (c == '\n' || _readBuffer.full())
+                _readinessWaiters.notifyAll();
         } catch (const std::bad_alloc&) {
             _readBuffer.pop_front();
             _serialHandler(nullptr, c);
@@ -134,6 +137,23 @@ async::future<ssize_t> ConsoleDevice::_writeOne(const IoVector& iov, off64_t off
         });
 }
 
+short ConsoleDevice::getReadiness() {
+    // Reads wait for a whole line, unless there's no room left for the rest
+    // of it
+    short readiness = POLLOUT;
+    if (_readBuffer.full() || std::find(_readBuffer.begin(), _readBuffer.end(), '\n') != _readBuffer.end())
+        readiness |= POLLIN;
+    return readiness;
+}
+
+void ConsoleDevice::addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) {
+    _readinessWaiters.add(std::move(waiter));
+}
+
+void ConsoleDevice::removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept {
+    _readinessWaiters.remove(waiter);
+}
+
 async::future<int> ConsoleDevice::ioctl(size_t request, memory::UserMemory argp) {
     if (request != TIOCGWINSZ)
         throw std::invalid_argument("Unknown ioctl on console device");
@@ -0,0 +1,125 @@
+#include <stdexcept>
+#include <system_error>
+
+#include "internal/fs/EventPoll.h"
+
+namespace fs {
+
+void EventPoll::add(int fd, std::shared_ptr<File> file, epoll_event event) {
+    if (std::dynamic_pointer_cast<EventPoll>(file))
+        throw std::invalid_argument("Nested epoll instances are not supported");
+    if (event.events & EPOLLET)
+        throw std::invalid_argument("Edge triggered events are not supported");
+    if (_find(fd, file) != _interests.end())
+        throw std::system_error(EEXIST, std::system_category(), "File already added");
+
+    _interests[fd] = Interest{.file = file, .event = event};
+
+    // Have anyone waiting check the new file, and wait on it too if it's
+    // not ready yet
+    _readinessWaiters.notifyAll();
+}
+
+void EventPoll::modify(int fd, std::shared_ptr<File> file, epoll_event event) {
+    if (event.events & EPOLLET)
+        throw std::invalid_argument("Edge triggered events are not supported");
+
+    auto interest = _find(fd, file);
+    if (interest == _interests.end())
+        throw std::system_error(ENOENT, std::system_category(), "File not added");
+
+    interest->second.event = event;
+    _readinessWaiters.notifyAll();
+}
+
+void EventPoll::remove(int fd, std::shared_ptr<File> file) {
+    auto interest = _find(fd, file);
+    if (interest == _interests.end())
+        throw std::system_error(ENOENT, std::system_category(), "File not added");
+
+    _interests.erase(interest);
+}
+
+std::vector<epoll_event> EventPoll::getReadyEvents(size_t maxEvents) {
+    std::vector<epoll_event> result;
+    for (auto interest = _interests.begin(); interest != _interests.end() && result.size() < maxEvents;) {
+        auto file = interest->second.file.lock();
+        if (!file) {
+            interest = _interests.erase(interest);
+            continue;
+        }
+
+        uint32_t events = _getReadyEvents(interest->second, *file);
+        if (events) {
+            result.push_back(epoll_event{.events = events, .data = interest->second.event.data});
+            if (interest->second.event.events & EPOLLONESHOT)
+                interest->second.event.events = EPOLLONESHOT;
+        }
+
+        ++interest;
+    }
+
+    return result;
+}
+
+std::vector<std::shared_ptr<File>> EventPoll::getFiles() {
+    std::vector<std::shared_ptr<File>> result;
+    for (const auto& interest : _interests) {
+        if (auto file = interest.second.file.lock())
+            result.push_back(std::move(file));
+    }
+
+    return result;
+}
+
+short EventPoll::getReadiness() {
+    for (const auto& interest : _interests) {
+        auto file = interest.second.file.lock();
+        if (file && _getReadyEvents(interest.second, *file))
+            return POLLIN;
+    }
+
+    return 0;
+}
+
+void EventPoll::addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) {
+    for (const auto& file : getFiles())
+        file->addReadinessWaiter(waiter);
+    _readinessWaiters.add(std::move(waiter));
+}
+
+void EventPoll::removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept {
+    for (const auto& interest : _interests) {
+        if (auto file = interest.second.file.lock())
+            file->removeReadinessWaiter(waiter);
+    }
+    _readinessWaiters.remove(waiter);
+}
+
+std::map<int, EventPoll::Interest>::iterator EventPoll::_find(int fd, const std::shared_ptr<File>& file) {
+    auto interest = _interests.find(fd);
+    if (interest == _interests.end())
+        return interest;
+
+    // The file descriptor might have been closed and reused since
+    auto interestFile = interest->second.file.lock();
+    if (interestFile != file) {
+        if (!interestFile)
+            _interests.erase(interest);
+        return _interests.end();
+    }
+
+    return interest;
+}
+
+uint32_t EventPoll::_getReadyEvents(const Interest& interest, File& file) {
+    // Disabled by EPOLLONESHOT until modified again
+    if (!(interest.event.events & ~EPOLLONESHOT))
+        return 0;
+
+    // Error and hangup are always reported, like with poll()
+    uint32_t readiness = static_cast<unsigned short>(file.getReadiness());
+    return readiness & (interest.event.events | EPOLLERR | EPOLLHUP);
+}
+
+}
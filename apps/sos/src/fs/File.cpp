@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <limits>
 #include <stdexcept>
 #include <system_error>
@@ -6,9 +8,34 @@
 #include <dirent.h>
 
 #include "internal/fs/File.h"
+#include "internal/timer/timer.h"
 
 namespace fs {
 
+void ReadinessWaiters::add(std::shared_ptr<ReadinessWaiter> waiter) {
+    _waiters.erase(std::remove_if(_waiters.begin(), _waiters.end(), [](const auto& waiter) {
+        return waiter->isFinished();
+    }), _waiters.end());
+
+    if (std::find(_waiters.cbegin(), _waiters.cend(), waiter) == _waiters.cend())
+        _waiters.push_back(std::move(waiter));
+}
+
+void ReadinessWaiters::remove(const ReadinessWaiter& waiter) noexcept {
+    _waiters.erase(std::remove_if(_waiters.begin(), _waiters.end(), [&waiter](const auto& _waiter) {
+        return _waiter.get() == &waiter;
+    }), _waiters.end());
+}
+
+void ReadinessWaiters::notifyAll() noexcept {
+    // Waiters can add themselves back while being notified
+    auto waiters = std::move(_waiters);
+    _waiters.clear();
+
+    for (const auto& waiter : waiters)
+        waiter->notify();
+}
+
 async::future<ssize_t> File::read(const std::vector<IoVector>& iov, off64_t offset) {
     auto future = async::make_ready_future<ssize_t>(0);
 
@@ -36,7 +63,7 @@ async::future<ssize_t> File::read(const std::vector<IoVector>& iov, off64_t offs
     return future;
 }
 
-async::future<ssize_t> File::write(const std::vector<IoVector>& iov, off64_t offset) {
+async::future<ssize_t> File::write(const std::vector<IoVector>& iov, off64_t offset, bool /*isNonBlocking*/) {
     auto future = async::make_ready_future<ssize_t>(0);
 
     ssize_t expectedBytesWritten = 0;
@@ -67,6 +94,16 @@ async::future<int> File::ioctl(size_t /*request*/, memory::UserMemory /*argp*/)
     throw std::invalid_argument("File not ioctl'able");
 }
 
+short File::getReadiness() {
+    return POLLIN | POLLOUT;
+}
+
+void File::addReadinessWaiter(std::shared_ptr<ReadinessWaiter> /*waiter*/) {
+}
+
+void File::removeReadinessWaiter(const ReadinessWaiter& /*waiter*/) noexcept {
+}
+
 async::future<ssize_t> File::_readOne(const IoVector& /*iov*/, off64_t /*offset*/) {
     throw std::invalid_argument("File not readable");
 }
@@ -79,7 +116,7 @@ async::future<ssize_t> Directory::read(const std::vector<IoVector>& /*iov*/, off
     throw std::system_error(EISDIR, std::system_category(), "Directory not directly readable");
 }
 
-async::future<ssize_t> Directory::write(const std::vector<IoVector>& /*iov*/, off64_t /*offset*/) {
+async::future<ssize_t> Directory::write(const std::vector<IoVector>& /*iov*/, off64_t /*offset*/, bool /*isNonBlocking*/) {
     throw std::system_error(EISDIR, std::system_category(), "Directory not directly writable");
 }
 
@@ -98,6 +135,189 @@ dirent* Directory::_alignNextDirent(dirent* curDirent, size_t nameLength) {
     return nextDirent;
 }
 
+namespace {
+    class ReadinessWait : public ReadinessWaiter, public std::enable_shared_from_this<ReadinessWait> {
+        public:
+            ReadinessWait(std::vector<std::shared_ptr<File>> files, std::function<int ()> check):
+                _files(std::move(files)),
+                _check(std::move(check)),
+                _timer(0),
+                _isDone(false)
+            {}
+
+            async::future<int> start(int timeout) {
+                auto future = _promise.get_future();
+
+                notify();
+                if (!_isDone && timeout >= 0) {
+                    auto self = shared_from_this();
+                    _timer = timer::setTimer(
+                        std::chrono::duration_cast<timer::Duration>(std::chrono::milliseconds(timeout)),
+                        [self] {
+                            self->_timer = 0;
+                            if (!self->_isDone)
+                                self->_checkAndFinish(true);
+                        }
+                    );
+                }
+
+                return future;
+            }
+
+            virtual void notify() noexcept override {
+                if (!_isDone)
+                    _checkAndFinish(false);
+            }
+
+            virtual bool isFinished() const noexcept override {
+                return _isDone;
+            }
+
+        private:
+            void _checkAndFinish(bool isTimedOut) noexcept {
+                try {
+                    int result = _check();
+                    if (result != 0 || isTimedOut) {
+                        _finish();
+                        _promise.set_value(result);
+                        return;
+                    }
+
+                    auto self = shared_from_this();
+                    for (const auto& file : _files)
+                        file->addReadinessWaiter(self);
+                } catch (...) {
+                    _finish();
+                    _promise.set_exception(std::current_exception());
+                }
+            }
+
+            void _finish() noexcept {
+                _isDone = true;
+                if (_timer)
+                    timer::clearTimer(_timer);
+
+                // The files' waiter lists might be all that's keeping us alive
+                auto self = shared_from_this();
+                for (const auto& file : _files)
+                    file->removeReadinessWaiter(*this);
+                _files.clear();
+                _check = nullptr;
+            }
+
+            std::vector<std::shared_ptr<File>> _files;
+            std::function<int ()> _check;
+            async::promise<int> _promise;
+
+            timer::TimerId _timer;
+            bool _isDone;
+    };
+
+    // Big enough that each chunk is a few NFS RPCs, so the reads and writes
+    // overlap for most of a copy
+    constexpr const size_t COPY_CHUNK_SIZE = 32 * 1024;
+
+    struct Copy {
+        std::shared_ptr<File> in, out;
+        off64_t inOffset, outOffset;
+        size_t remaining; // Not read yet
+        ssize_t copied;
+
+        // Two chunks, so one can be read into while the other is written out
+        std::unique_ptr<uint8_t[]> buffer;
+    };
+
+    IoVector _getCopyBuffer(const Copy& copy, size_t chunk, size_t length) {
+        return IoVector{
+            .buffer = memory::UserMemory(
+                process::getSosProcess(),
+                reinterpret_cast<memory::vaddr_t>(copy.buffer.get() + chunk * COPY_CHUNK_SIZE)
+            ),
+            .length = length
+        };
+    }
+
+    async::future<ssize_t> _copyRead(std::shared_ptr<Copy> copy, size_t chunk) {
+        size_t length = std::min(copy->remaining, COPY_CHUNK_SIZE);
+        if (length == 0)
+            return async::make_ready_future<ssize_t>(0);
+
+        return copy->in->read({_getCopyBuffer(*copy, chunk, length)}, copy->inOffset).then([copy](auto read) {
+            ssize_t _read = read.get();
+            copy->remaining -= _read;
+            if (copy->inOffset != CURRENT_OFFSET)
+                copy->inOffset += _read;
+            return _read;
+        });
+    }
+
+    // Returns whether to keep going
+    bool _finishCopyWrite(Copy& copy, ssize_t read, ssize_t written) {
+        copy.copied += written;
+        if (copy.outOffset != CURRENT_OFFSET)
+            copy.outOffset += written;
+        return written == read;
+    }
+
+    async::future<ssize_t> _copyWrite(std::shared_ptr<Copy> copy, size_t chunk, async::future<ssize_t> read) {
+        return read.then([copy, chunk](auto read) {
+            ssize_t _read = read.get();
+            if (_read == 0)
+                return async::make_ready_future(copy->copied);
+
+            auto written = copy->out->write({_getCopyBuffer(*copy, chunk, _read)}, copy->outOffset);
+
+            // Reading ahead from the file's own offset would lose what was
+            // read if this write comes up short, so wait for it instead
+            if (copy->inOffset == CURRENT_OFFSET) {
+                return written.then([copy, chunk, _read](auto written) {
+                    if (!_finishCopyWrite(*copy, _read, written.get()))
+                        return async::make_ready_future(copy->copied);
+                    return _copyWrite(copy, 1 - chunk, _copyRead(copy, 1 - chunk));
+                }).unwrap();
+            }
+
+            return async::when_all(
+                std::move(written),
+                _copyRead(copy, 1 - chunk)
+            ).then([copy, chunk, _read](auto results) {
+                auto _results = results.get();
+                if (!_finishCopyWrite(*copy, _read, std::get<0>(_results).get()))
+                    return async::make_ready_future(copy->copied);
+                return _copyWrite(copy, 1 - chunk, std::move(std::get<1>(_results)));
+            }).unwrap();
+        }).unwrap();
+    }
+}
+
+async::future<ssize_t> copy(std::shared_ptr<File> in, off64_t inOffset, std::shared_ptr<File> out, off64_t outOffset, size_t count) {
+    count = std::min(count, static_cast<size_t>(std::numeric_limits<ssize_t>::max()));
+    if (count == 0)
+        return async::make_ready_future<ssize_t>(0);
+
+    auto copy = std::make_shared<Copy>(Copy{
+        .in = in, .out = out,
+        .inOffset = inOffset, .outOffset = outOffset,
+        .remaining = count,
+        .copied = 0,
+        .buffer = std::unique_ptr<uint8_t[]>(new uint8_t[2 * COPY_CHUNK_SIZE])
+    });
+
+    return _copyWrite(copy, 0, _copyRead(copy, 0)).then([copy](auto copied) {
+        try {
+            return copied.get();
+        } catch (...) {
+            if (copy->copied == 0)
+                throw;
+            return copy->copied;
+        }
+    });
+}
+
+async::future<int> waitForReadiness(std::vector<std::shared_ptr<File>> files, std::function<int ()> check, int timeout) {
+    return std::make_shared<ReadinessWait>(std::move(files), std::move(check))->start(timeout);
+}
+
 std::unique_ptr<FileSystem> rootFileSystem;
 
 }
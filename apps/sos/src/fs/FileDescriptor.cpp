@@ -1,3 +1,4 @@
+#include <stdexcept>
 #include <system_error>
 
 #include "internal/fs/FileDescriptor.h"
@@ -8,9 +9,10 @@ namespace fs {
 // OpenFile //
 //////////////
 
-OpenFile::OpenFile(std::shared_ptr<File> file, OpenFile::Flags flags):
+OpenFile::OpenFile(std::shared_ptr<File> file, OpenFile::Flags flags, bool isNonBlocking):
     _file(std::move(file)),
-    _flags(flags)
+    _flags(flags),
+    _isNonBlocking(isNonBlocking)
 {}
 
 std::shared_ptr<File> OpenFile::get(OpenFile::Flags flags) const {
@@ -26,29 +28,30 @@ std::shared_ptr<File> OpenFile::get(OpenFile::Flags flags) const {
 // FDTable //
 /////////////
 
-FileDescriptor FDTable::insert(std::shared_ptr<OpenFile> file) {
+FileDescriptor FDTable::insert(std::shared_ptr<OpenFile> file, bool isCloseOnExec, FileDescriptor minFd) {
+    if (minFd < 0 || static_cast<size_t>(minFd) >= MAX_FILE_DESCRIPTORS)
+        throw std::invalid_argument("Invalid file descriptor");
     if (_table.size() >= MAX_FILE_DESCRIPTORS)
         throw std::system_error(EMFILE, std::system_category(), "Too many file descriptors being used");
 
-    auto entry = _table.cbegin();
-    if (entry == _table.cend() || entry->first != 0) {
-        _table.insert(std::make_pair(0, std::move(file)));
-        return 0;
-    }
+    FileDescriptor nextFd = minFd;
+    for (auto entry = _table.lower_bound(minFd); entry != _table.cend() && entry->first == nextFd; ++entry)
+        ++nextFd;
 
-    FileDescriptor nextFd = entry->first + 1;
-    for (++entry; entry != _table.cend(); ++entry) {
-        if (entry->first != nextFd) {
-            _table.insert(std::make_pair(nextFd, std::move(file)));
-            return nextFd;
-        }
-        nextFd = entry->first + 1;
-    }
+    if (static_cast<size_t>(nextFd) >= MAX_FILE_DESCRIPTORS)
+        throw std::system_error(EMFILE, std::system_category(), "Too many file descriptors being used");
 
-    _table.insert(std::make_pair(nextFd, std::move(file)));
+    _table.insert(std::make_pair(nextFd, Entry{std::move(file), isCloseOnExec}));
     return nextFd;
 }
 
+void FDTable::insertAt(FileDescriptor fd, std::shared_ptr<OpenFile> file, bool isCloseOnExec) {
+    if (fd < 0 || static_cast<size_t>(fd) >= MAX_FILE_DESCRIPTORS)
+        throw std::system_error(EBADF, std::system_category(), "Invalid file descriptor");
+
+    _table[fd] = Entry{std::move(file), isCloseOnExec};
+}
+
 bool FDTable::erase(FileDescriptor fd) noexcept {
     return _table.erase(fd);
 }
@@ -58,6 +61,36 @@ void FDTable::clear() noexcept {
 }
 
 std::shared_ptr<OpenFile> FDTable::get(FileDescriptor fd) const {
+    return _getEntry(fd).file;
+}
+
+std::shared_ptr<File> FDTable::get(FileDescriptor fd, OpenFile::Flags flags) const {
+    return get(fd)->get(flags);
+}
+
+bool FDTable::isCloseOnExec(FileDescriptor fd) const {
+    return _getEntry(fd).isCloseOnExec;
+}
+
+void FDTable::setCloseOnExec(FileDescriptor fd, bool isCloseOnExec) {
+    auto entry = _table.find(fd);
+    if (entry == _table.end())
+        throw std::system_error(EBADF, std::system_category());
+
+    entry->second.isCloseOnExec = isCloseOnExec;
+}
+
+FDTable FDTable::forExec() const {
+    FDTable result;
+    for (const auto& entry : _table) {
+        if (!entry.second.isCloseOnExec)
+            result._table.insert(entry);
+    }
+
+    return result;
+}
+
+const FDTable::Entry& FDTable::_getEntry(FileDescriptor fd) const {
     try {
         return _table.at(fd);
     } catch (const std::out_of_range&) {
@@ -65,8 +98,4 @@ std::shared_ptr<OpenFile> FDTable::get(FileDescriptor fd) const {
     }
 }
 
-std::shared_ptr<File> FDTable::get(FileDescriptor fd, OpenFile::Flags flags) const {
-    return get(fd)->get(flags);
-}
-
 }
@@ -0,0 +1,448 @@
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <limits.h>
+
+#include "internal/fs/Pipe.h"
+
+namespace fs {
+
+namespace {
+    // Same as Linux' default
+    constexpr const size_t PIPE_PAGES = 16;
+    constexpr const size_t PIPE_CAPACITY = PIPE_PAGES * PAGE_SIZE;
+
+    // Like File::read(), but only moves on to the next vector if there's
+    // more in the pipe already, so it doesn't block after reading something
+    async::future<ssize_t> _readv(std::shared_ptr<Pipe> pipe, std::shared_ptr<std::vector<IoVector>> iov, size_t index, ssize_t bytesRead) {
+        if (index == iov->size() || (bytesRead > 0 && !(pipe->getReadReadiness() & POLLIN)))
+            return async::make_ready_future(bytesRead);
+
+        return pipe->read((*iov)[index]).then([=](auto read) {
+            ssize_t _read;
+            try {
+                _read = read.get();
+            } catch (...) {
+                if (bytesRead == 0)
+                    throw;
+                return async::make_ready_future(bytesRead);
+            }
+
+            if (static_cast<size_t>(_read) != (*iov)[index].length)
+                return async::make_ready_future(bytesRead + _read);
+
+            return _readv(pipe, iov, index + 1, bytesRead + _read);
+        }).unwrap();
+    }
+
+    // Like File::write(), but passes on whether to block to each vector's
+    // write so a non-blocking one stops once the pipe is full
+    async::future<ssize_t> _writev(std::shared_ptr<Pipe> pipe, std::shared_ptr<std::vector<IoVector>> iov, size_t index, ssize_t bytesWritten, bool isNonBlocking) {
+        if (index == iov->size())
+            return async::make_ready_future(bytesWritten);
+
+        return pipe->write((*iov)[index], isNonBlocking).then([=](auto written) {
+            ssize_t _written;
+            try {
+                _written = written.get();
+            } catch (...) {
+                if (bytesWritten == 0)
+                    throw;
+                return async::make_ready_future(bytesWritten);
+            }
+
+            if (static_cast<size_t>(_written) != (*iov)[index].length)
+                return async::make_ready_future(bytesWritten + _written);
+
+            try {
+                return _writev(pipe, iov, index + 1, bytesWritten + _written, isNonBlocking);
+            } catch (...) {
+                // The read end closed since the last vector was written
+                return async::make_ready_future(bytesWritten + _written);
+            }
+        }).unwrap();
+    }
+}
+
+//////////
+// Pipe //
+//////////
+
+std::pair<std::shared_ptr<File>, std::shared_ptr<File>> Pipe::create() {
+    std::shared_ptr<Pipe> pipe(new Pipe);
+    return std::make_pair(
+        std::shared_ptr<File>(new PipeReadEnd(pipe)),
+        std::shared_ptr<File>(new PipeWriteEnd(pipe))
+    );
+}
+
+async::future<ssize_t> Pipe::read(const IoVector& iov) {
+    if (iov.length == 0)
+        return async::make_ready_future<ssize_t>(0);
+
+    _readRequests.push_back(Request{iov, 0, false, async::promise<ssize_t>()});
+    auto future = _readRequests.back().promise.get_future();
+    _process();
+    return future;
+}
+
+async::future<ssize_t> Pipe::write(const IoVector& iov, bool isNonBlocking) {
+    if (!_hasReadEnd)
+        throw std::system_error(EPIPE, std::system_category(), "Pipe has no read end");
+    if (iov.length == 0)
+        return async::make_ready_future<ssize_t>(0);
+
+    _writeRequests.push_back(Request{iov, 0, isNonBlocking, async::promise<ssize_t>()});
+    auto future = _writeRequests.back().promise.get_future();
+    _process();
+    return future;
+}
+
+short Pipe::getReadReadiness() const noexcept {
+    // Reads return end of file straight away once there are no writers
+    short readiness = 0;
+    if (_size > 0 || !_writeRequests.empty())
+        readiness |= POLLIN;
+    if (!_hasWriteEnd)
+        readiness |= POLLIN | POLLHUP;
+    return readiness;
+}
+
+short Pipe::getWriteReadiness() const noexcept {
+    // Writes fail straight away once there are no readers
+    if (!_hasReadEnd)
+        return POLLOUT | POLLERR;
+    return _size < PIPE_CAPACITY ? POLLOUT : 0;
+}
+
+bool Pipe::hasRoomFor(size_t bytes) const noexcept {
+    // Writes already queued get the room first
+    size_t queued = _size;
+    for (const auto& request : _writeRequests)
+        queued += request.iov.length - request.done;
+    return queued <= PIPE_CAPACITY && PIPE_CAPACITY - queued >= bytes;
+}
+
+void Pipe::addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) {
+    _readinessWaiters.add(std::move(waiter));
+}
+
+void Pipe::removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept {
+    _readinessWaiters.remove(waiter);
+}
+
+void Pipe::closeReadEnd() noexcept {
+    _hasReadEnd = false;
+    _readinessWaiters.notifyAll();
+    _process();
+}
+
+void Pipe::closeWriteEnd() noexcept {
+    _hasWriteEnd = false;
+    _readinessWaiters.notifyAll();
+    _process();
+}
+
+void Pipe::_process() noexcept {
+    while (!_isTransferring) {
+        if (!_hasReadEnd) {
+            // Reads can only be left over from a reader that was killed
+            for (auto& request : _readRequests)
+                request.promise.set_exception(std::system_error(EBADF, std::system_category()));
+            _readRequests.clear();
+
+            for (auto& request : _writeRequests) {
+                if (request.done > 0)
+                    request.promise.set_value(request.done);
+                else
+                    request.promise.set_exception(std::system_error(EPIPE, std::system_category()));
+            }
+            _writeRequests.clear();
+
+            // Nobody can read what's left
+            _pages.clear();
+            _sparePage = memory::Page();
+            _readOffset = 0;
+            _writeOffset = PAGE_SIZE;
+            _size = 0;
+            return;
+        }
+
+        if (!_readRequests.empty()) {
+            if (_size > 0) {
+                _readFromBuffer();
+                continue;
+            } else if (!_writeRequests.empty()) {
+                _handOff();
+                continue;
+            } else if (!_hasWriteEnd) {
+                auto& request = _readRequests.front();
+                request.promise.set_value(request.done);
+                _readRequests.pop_front();
+                continue;
+            }
+        }
+
+        if (!_writeRequests.empty() && _size < PIPE_CAPACITY) {
+            _writeToBuffer();
+            continue;
+        }
+
+        // Only a reader can make room now, so non-blocking writes stop here
+        // with whatever they managed to write
+        for (auto request = _writeRequests.begin(); request != _writeRequests.end();) {
+            if (!request->isNonBlocking) {
+                ++request;
+                continue;
+            }
+
+            if (request->done > 0)
+                request->promise.set_value(request->done);
+            else
+                request->promise.set_exception(std::system_error(EAGAIN, std::system_category()));
+            request = _writeRequests.erase(request);
+        }
+
+        return;
+    }
+}
+
+void Pipe::_readFromBuffer() noexcept {
+    auto& request = _readRequests.front();
+
+    size_t end = _pages.size() == 1 ? _writeOffset : PAGE_SIZE;
+    size_t bytes = std::min(request.iov.length - request.done, end - _readOffset);
+
+    _isTransferring = true;
+    auto self = shared_from_this();
+    try {
+        uint8_t* data = _pages.front().getWindowAddress() + _readOffset;
+        (request.iov.buffer + request.done).write(data, data + bytes).then([self, bytes](async::future<void> result) noexcept {
+            try {
+                result.get();
+            } catch (...) {
+                self->_failTransfer(self->_readRequests, std::current_exception());
+                return;
+            }
+
+            self->_readOffset += bytes;
+            self->_size -= bytes;
+            if (self->_readOffset == PAGE_SIZE && self->_pages.size() > 1) {
+                // Keep one page around so a steady stream doesn't need to
+                // allocate a page every time
+                if (!self->_sparePage)
+                    self->_sparePage = std::move(self->_pages.front());
+                self->_pages.pop_front();
+                self->_readOffset = 0;
+            }
+            if (self->_size == 0) {
+                self->_readOffset = 0;
+                self->_writeOffset = 0;
+            }
+
+            auto& request = self->_readRequests.front();
+            request.done += bytes;
+            self->_finishTransfer(self->_readRequests, request.done == request.iov.length || self->_size == 0);
+        });
+    } catch (...) {
+        _failTransfer(_readRequests, std::current_exception());
+    }
+}
+
+void Pipe::_writeToBuffer() noexcept {
+    _isTransferring = true;
+    auto self = shared_from_this();
+
+    if (_writeOffset == PAGE_SIZE) {
+        if (_sparePage) {
+            _pages.push_back(std::move(_sparePage));
+            _writeOffset = 0;
+        } else {
+            try {
+                memory::FrameTable::alloc().then([self](auto page) noexcept {
+                    try {
+                        self->_pages.push_back(page.get());
+                    } catch (...) {
+                        self->_failTransfer(self->_writeRequests, std::current_exception());
+                        return;
+                    }
+
+                    self->_writeOffset = 0;
+                    self->_isTransferring = false;
+                    self->_process();
+                });
+            } catch (...) {
+                _failTransfer(_writeRequests, std::current_exception());
+            }
+            return;
+        }
+    }
+
+    auto& request = _writeRequests.front();
+    size_t bytes = std::min({request.iov.length - request.done, PAGE_SIZE - _writeOffset, PIPE_CAPACITY - _size});
+
+    try {
+        uint8_t* data = _pages.back().getWindowAddress() + _writeOffset;
+        (request.iov.buffer + request.done).read(data, data + bytes).then([self, bytes](async::future<void> result) noexcept {
+            try {
+                result.get();
+            } catch (...) {
+                self->_failTransfer(self->_writeRequests, std::current_exception());
+                return;
+            }
+
+            self->_writeOffset += bytes;
+            self->_size += bytes;
+
+            auto& request = self->_writeRequests.front();
+            request.done += bytes;
+            self->_finishTransfer(self->_writeRequests, request.done == request.iov.length);
+        });
+    } catch (...) {
+        _failTransfer(_writeRequests, std::current_exception());
+    }
+}
+
+void Pipe::_handOff() noexcept {
+    // The buffer is empty and a reader is already waiting, so copy straight
+    // from the writer to the reader instead of going through the pages
+    auto& reader = _readRequests.front();
+    auto& writer = _writeRequests.front();
+    size_t bytes = std::min({reader.iov.length - reader.done, writer.iov.length - writer.done, PIPE_CAPACITY});
+
+    _isTransferring = true;
+    auto self = shared_from_this();
+    try {
+        (reader.iov.buffer + reader.done).mapIn<uint8_t>(bytes, memory::Attributes{.read = false, .write = true})
+            .then([self, bytes](auto map) noexcept {
+                std::shared_ptr<std::pair<uint8_t*, memory::ScopedMapping>> _map;
+                try {
+                    _map = std::make_shared<std::pair<uint8_t*, memory::ScopedMapping>>(std::move(map.get()));
+                } catch (...) {
+                    self->_failTransfer(self->_readRequests, std::current_exception());
+                    return;
+                }
+
+                try {
+                    auto& writer = self->_writeRequests.front();
+                    (writer.iov.buffer + writer.done).read(_map->first, _map->first + bytes).then([self, bytes, _map](async::future<void> result) noexcept {
+                        try {
+                            result.get();
+                        } catch (...) {
+                            self->_failTransfer(self->_writeRequests, std::current_exception());
+                            return;
+                        }
+
+                        auto& reader = self->_readRequests.front();
+                        reader.promise.set_value(reader.done + bytes);
+                        self->_readRequests.pop_front();
+
+                        auto& writer = self->_writeRequests.front();
+                        writer.done += bytes;
+                        self->_finishTransfer(self->_writeRequests, writer.done == writer.iov.length);
+                    });
+                } catch (...) {
+                    self->_failTransfer(self->_writeRequests, std::current_exception());
+                }
+            });
+    } catch (...) {
+        _failTransfer(_readRequests, std::current_exception());
+    }
+}
+
+void Pipe::_finishTransfer(std::deque<Request>& requests, bool isComplete) noexcept {
+    _isTransferring = false;
+
+    if (isComplete) {
+        auto& request = requests.front();
+        request.promise.set_value(request.done);
+        requests.pop_front();
+    }
+
+    _readinessWaiters.notifyAll();
+    _process();
+}
+
+void Pipe::_failTransfer(std::deque<Request>& requests, std::exception_ptr exception) noexcept {
+    _isTransferring = false;
+
+    // Like read() and write(), report how much was done if it was something
+    auto& request = requests.front();
+    if (request.done > 0)
+        request.promise.set_value(request.done);
+    else
+        request.promise.set_exception(exception);
+    requests.pop_front();
+
+    _readinessWaiters.notifyAll();
+    _process();
+}
+
+/////////////////
+// PipeReadEnd //
+/////////////////
+
+PipeReadEnd::~PipeReadEnd() {
+    _pipe->closeReadEnd();
+}
+
+async::future<ssize_t> PipeReadEnd::read(const std::vector<IoVector>& iov, off64_t offset) {
+    if (offset != CURRENT_OFFSET)
+        throw std::system_error(ESPIPE, std::system_category(), "Cannot seek a pipe");
+
+    return _readv(_pipe, std::make_shared<std::vector<IoVector>>(iov), 0, 0);
+}
+
+short PipeReadEnd::getReadiness() {
+    return _pipe->getReadReadiness();
+}
+
+void PipeReadEnd::addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) {
+    _pipe->addReadinessWaiter(std::move(waiter));
+}
+
+void PipeReadEnd::removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept {
+    _pipe->removeReadinessWaiter(waiter);
+}
+
+//////////////////
+// PipeWriteEnd //
+//////////////////
+
+PipeWriteEnd::~PipeWriteEnd() {
+    _pipe->closeWriteEnd();
+}
+
+async::future<ssize_t> PipeWriteEnd::write(const std::vector<IoVector>& iov, off64_t offset, bool isNonBlocking) {
+    if (offset != CURRENT_OFFSET)
+        throw std::system_error(ESPIPE, std::system_category(), "Cannot seek a pipe");
+
+    // Writes of at most PIPE_BUF bytes are all or nothing, even when
+    // non-blocking. Once one fits it's written whole, so it can't be cut
+    // short by the buffer filling up
+    size_t length = 0;
+    for (const auto& vector : iov)
+        length += vector.length;
+    if (isNonBlocking && length <= PIPE_BUF) {
+        if (!_pipe->hasRoomFor(length))
+            throw std::system_error(EAGAIN, std::system_category(), "Not enough room in the pipe");
+        isNonBlocking = false;
+    }
+
+    return _writev(_pipe, std::make_shared<std::vector<IoVector>>(iov), 0, 0, isNonBlocking);
+}
+
+short PipeWriteEnd::getReadiness() {
+    return _pipe->getWriteReadiness();
+}
+
+void PipeWriteEnd::addReadinessWaiter(std::shared_ptr<ReadinessWaiter> waiter) {
+    _pipe->addReadinessWaiter(std::move(waiter));
+}
+
+void PipeWriteEnd::removeReadinessWaiter(const ReadinessWaiter& waiter) noexcept {
+    _pipe->removeReadinessWaiter(waiter);
+}
+
+}
@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "internal/fs/DeviceFileSystem.h"
+#include "internal/fs/StatsDevice.h"
+#include "internal/stats.h"
+
+namespace fs {
+
+StatsDevice::StatsDevice(std::string contents):
+    _contents(std::move(contents)),
+    _position(0)
+{}
+
+void StatsDevice::mountOn(DeviceFileSystem& fs, const std::string& name) {
+    fs.create(name, [](auto flags) {
+        if (flags.write)
+            throw std::invalid_argument("Statistics are read-only");
+
+        return async::make_ready_future(std::shared_ptr<File>(new StatsDevice(stats::format())));
+    });
+}
+
+async::future<ssize_t> StatsDevice::_readOne(const IoVector& iov, off64_t offset) {
+    if (offset != CURRENT_OFFSET && offset < 0)
+        throw std::invalid_argument("Invalid offset");
+
+    size_t start = offset == CURRENT_OFFSET ? _position : static_cast<size_t>(std::min<off64_t>(offset, _contents.size()));
+    size_t length = std::min(iov.length, _contents.size() - start);
+    if (offset == CURRENT_OFFSET)
+        _position += length;
+
+    // Copies the range first, so it doesn't matter if we're closed before
+    // the write finishes
+    return memory::UserMemory(iov.buffer).write(_contents.cbegin() + start, _contents.cbegin() + start + length)
+        .then([length](async::future<void> result) {
+            result.get();
+            return static_cast<ssize_t>(length);
+        });
+}
+
+}
@@ -26,12 +26,17 @@ extern "C" {
     #include "internal/sys/panic.h"
 }
 
+#include "internal/async.h"
+#include "internal/benchmark.h"
 #include "internal/globals.h"
+#include "internal/selftest.h"
+#include "internal/ObjectCache.h"
 #include "internal/fs/ConsoleDevice.h"
 #include "internal/fs/DebugDevice.h"
 #include "internal/fs/DeviceFileSystem.h"
 #include "internal/fs/FlatFileSystem.h"
 #include "internal/fs/NFSFileSystem.h"
+#include "internal/fs/StatsDevice.h"
 #include "internal/memory/FrameTable.h"
 #include "internal/memory/Swap.h"
 #include "internal/process/Table.h"
@@ -166,6 +171,12 @@ namespace {
             "Failed to bind IRQ EP to TCB"
         );
 
+        // Stay above every user thread, whatever their nice values
+        conditional_panic(
+            seL4_TCB_SetPriority(seL4_CapInitThreadTCB, seL4_MaxPrio),
+            "Failed to set SOS's priority"
+        );
+
         // Set stdin/out/err to the debug device
         auto debugDevice = std::make_shared<fs::OpenFile>(
             std::make_shared<fs::DebugDevice>(),
@@ -188,6 +199,17 @@ namespace {
         conditional_panic(!badgedCap, "Failed to allocate badged cap");
         return Capability<seL4_AsyncEndpointObject, seL4_EndpointBits>(0, badgedCap);
     }
+
+    void _handleIrqs(seL4_Word badge) {
+        // Anything the handlers complete gets run from the main loop instead
+        // of from inside them
+        async::RunQueue::Deferral deferral;
+
+        if (badge & IRQ_BADGE_NETWORK)
+            network_irq();
+        if (badge & IRQ_BADGE_TIMER)
+            timer::handleIrq();
+    }
 }
 
 int main() noexcept {
@@ -200,9 +222,17 @@ int main() noexcept {
     // Initialise the timer
     timer::init(_getBadgedIrqEndpoint(IRQ_BADGE_TIMER));
 
+#ifdef CONFIG_SOS_SELF_TEST
+    selftest::run();
+#endif
+#ifdef CONFIG_SOS_BENCHMARK
+    benchmark::run();
+#endif
+
     // Initialise the device filesystem
     auto deviceFileSystem = std::make_unique<fs::DeviceFileSystem>();
     fs::ConsoleDevice::mountOn(*deviceFileSystem, "console");
+    fs::StatsDevice::mountOn(*deviceFileSystem, "stats");
 
     // Initialise the root filesystem with the device filesystem and NFS
     auto rootFileSystem = std::make_unique<fs::FlatFileSystem>();
@@ -238,18 +268,51 @@ int main() noexcept {
     // Wait on synchronous endpoint for IPC
     kprintf(LOGLEVEL_INFO, "\nSOS entering syscall loop\n");
 
+    async::RunQueue& runQueue = async::RunQueue::get();
+    process::Reply reply = {.isReady = false};
     while (true) {
+        if (!runQueue.isEmpty()) {
+            // Don't hold up the caller behind everything else
+            if (reply.isReady) {
+                process::setReplyMRs(reply);
+                seL4_Reply(reply.message);
+                reply.isReady = false;
+            }
+
+            // Run whatever the last message made runnable, a batch at a time
+            // so pending interrupts don't have to wait for all of it
+            do {
+                runQueue.run(CONFIG_SOS_RUN_QUEUE_BUDGET);
+
+                seL4_Word badge;
+                seL4_Poll(_getIrqEndpoint().get(), &badge);
+                _handleIrqs(badge);
+            } while (!runQueue.isEmpty());
+        }
+
+        process::sendDeferredReplies();
+
         seL4_Word badge;
-        seL4_MessageInfo_t message = seL4_Wait(getIpcEndpoint().get(), &badge);
+        seL4_MessageInfo_t message;
+        if (reply.isReady) {
+            // Reply and wait in a single kernel entry, which can take the
+            // fastpath. Refilling the object caches can wait until we would
+            // otherwise block
+            process::setReplyMRs(reply);
+            message = seL4_ReplyWait(getIpcEndpoint().get(), reply.message, &badge);
+        } else {
+            // Everything that was waiting on us has been replied to, so now
+            // is a good time to prepare objects for later
+            refillObjectCaches();
+
+            message = seL4_Wait(getIpcEndpoint().get(), &badge);
+        }
+        reply.isReady = false;
 
         if (badge & IRQ_EP_BADGE) {
-            // Interrupt
-            if (badge & IRQ_BADGE_NETWORK)
-                network_irq();
-            if (badge & IRQ_BADGE_TIMER)
-                timer::handleIrq();
+            _handleIrqs(badge);
         } else {
-            process::ThreadTable::get().get(badge)->handleFault(message);
+            reply = process::ThreadTable::get().get(badge)->handleFault(message);
         }
     }
 }
@@ -1,8 +1,13 @@
 #include <stdexcept>
+#include <string>
+#include <system_error>
 #include <vector>
 #include <assert.h>
 
 extern "C" {
+    #include <cspace/cspace.h>
+    #include <sel4/sel4.h>
+
     #include "internal/ut_manager/ut.h"
 }
 
@@ -11,6 +16,7 @@ extern "C" {
 #include "internal/memory/PageDirectory.h"
 #include "internal/memory/Swap.h"
 #include "internal/process/Thread.h"
+#include "internal/ObjectCache.h"
 
 namespace memory {
 
@@ -25,6 +31,11 @@ namespace {
     paddr_t _start, _end;
     size_t _frameTablePages, _frameCount;
 
+    // Every frame has a fixed page in SOS' virtual memory it can be accessed
+    // through, so copying to and from other processes doesn't need to map and
+    // unmap pages each time
+    vaddr_t _windowStart;
+
     inline Frame& _getFrame(paddr_t address) {
         assert(_start <= address && address < _end);
         return _table[(address - _start) / PAGE_SIZE];
@@ -70,9 +81,18 @@ void Frame::erase(Page& page) noexcept {
         assert(page._prev);
     }
 
-    if (!_pages)
-        // We were the last copy, so free the frame
-        ut_free(getAddress(), seL4_PageBits);
+    if (!_pages) {
+        // We were the last copy, so free the frame, keeping it around for
+        // reuse if we can
+        _unmapWindow();
+        if (ObjectCache<seL4_ARM_SmallPageObject, seL4_PageBits>::get().give(getAddress(), page._resident.cap)) {
+            page._resident.cap = 0;
+        } else {
+            assert(cspace_delete_cap(cur_cspace, page._resident.cap) == CSPACE_NOERROR);
+            page._resident.cap = 0;
+            ut_free(getAddress(), seL4_PageBits);
+        }
+    }
 
     if (page._prev)
         page._prev->_next = page._next;
@@ -118,6 +138,50 @@ paddr_t Frame::getAddress() const {
     return _start + ((this - _table) * PAGE_SIZE);
 }
 
+uint8_t* Frame::getWindowAddress() {
+    assert(_pages);
+
+    vaddr_t address = _windowStart + ((this - _table) * PAGE_SIZE);
+    if (!_windowCap) {
+        seL4_ARM_Page cap = cspace_copy_cap(cur_cspace, cur_cspace, _pages->getCap(), seL4_AllRights);
+        if (cap == CSPACE_NULL)
+            throw std::system_error(ENOMEM, std::system_category(), "Failed to copy page cap");
+        assert(cap != 0);
+
+        auto& directory = process::getSosProcess()->pageDirectory;
+        seL4_ARM_VMAttributes attributes = static_cast<seL4_ARM_VMAttributes>(seL4_ARM_Default_VMAttributes | seL4_ARM_ExecuteNever);
+
+        int err = seL4_ARM_Page_Map(cap, directory.getCap(), address, seL4_AllRights, attributes);
+        if (err == seL4_FailedLookup) {
+            // First access to this part of the window
+            try {
+                directory.reservePageTable(address);
+            } catch (...) {
+                assert(cspace_delete_cap(cur_cspace, cap) == CSPACE_NOERROR);
+                throw;
+            }
+            err = seL4_ARM_Page_Map(cap, directory.getCap(), address, seL4_AllRights, attributes);
+        }
+        if (err != seL4_NoError) {
+            assert(cspace_delete_cap(cur_cspace, cap) == CSPACE_NOERROR);
+            throw std::system_error(ENOMEM, std::system_category(), "Failed to map in frame window: " + std::to_string(err));
+        }
+
+        _windowCap = cap;
+    }
+
+    return reinterpret_cast<uint8_t*>(address);
+}
+
+void Frame::_unmapWindow() noexcept {
+    if (!_windowCap)
+        return;
+
+    assert(seL4_ARM_Page_Unmap(_windowCap) == seL4_NoError);
+    assert(cspace_delete_cap(cur_cspace, _windowCap) == CSPACE_NOERROR);
+    _windowCap = 0;
+}
+
 void init(paddr_t start, paddr_t end) {
     _start = start;
     _end = end;
@@ -174,10 +238,23 @@ void init(paddr_t start, paddr_t end) {
 
     tableMap.release();
 
+    // Reserve the frame window. Pages are only mapped into it on first use
+    auto windowMap = process::getSosProcess()->maps.insert(
+        0, _frameCount,
+        attributes,
+        Mapping::Flags{.shared = false}
+    );
+    _windowStart = windowMap.getAddress();
+    windowMap.release();
+
     _isReady = true;
 }
 
-async::future<Page> alloc() {
+async::future<Page> alloc(int nice) {
+    auto cached = ObjectCache<seL4_ARM_SmallPageObject, seL4_PageBits>::get().take();
+    if (cached.second != 0)
+        return async::make_ready_future(Page(_getFrame(cached.first), cached.second));
+
     paddr_t address = ut_alloc(seL4_PageBits);
     if (!address) {
         static size_t clock;
@@ -187,7 +264,7 @@ async::future<Page> alloc() {
         size_t n = 1;
         for (; n < _frameCount * 2; ++n) {
             size_t f = (clock + n) % _frameCount;
-            if (!_table[f]._pages || _table[f]._isLocked)
+            if (!_table[f]._pages || _table[f]._isLocked || _table[f]._isSwappingOut)
                 continue;
 
             if (_table[f]._isReferenced) {
@@ -202,10 +279,14 @@ async::future<Page> alloc() {
         if (!toSwap)
             throw std::bad_alloc();
 
-        return memory::Swap::get().swapOut(*toSwap)
-            .then([](async::future<void> result) {
+        // Page faults can be in flight concurrently, so make sure nothing else
+        // picks this frame while it waits to be swapped out
+        toSwap->_isSwappingOut = true;
+
+        return memory::Swap::get().swapOut(*toSwap, nice)
+            .then([nice](async::future<void> result) {
                 result.get();
-                return alloc();
+                return alloc(nice);
             });
     }
 
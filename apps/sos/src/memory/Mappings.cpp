@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <stdexcept>
 #include <system_error>
 
@@ -15,11 +16,22 @@ extern "C" {
 
 namespace memory {
 
+/////////////
+// Backing //
+/////////////
+
+void Backing::fill(uint8_t* page, vaddr_t address) const noexcept {
+    vaddr_t from = std::max(address, start);
+    vaddr_t to = std::min(address + PAGE_SIZE, start + size);
+    if (from < to)
+        std::copy(data.get() + (from - start), data.get() + (to - start), page + (from - address));
+}
+
 //////////////
 // Mappings //
 //////////////
 
-ScopedMapping Mappings::insert(vaddr_t address, size_t pages, Attributes attributes, Mapping::Flags flags) {
+ScopedMapping Mappings::insert(vaddr_t address, size_t pages, Attributes attributes, Mapping::Flags flags, std::shared_ptr<const Backing> backing) {
     _checkAddress(address, pages);
 
     if (flags.shared)
@@ -69,7 +81,8 @@ haveValidAddress:
         .start = address,
         .end = address + pages * PAGE_SIZE,
         .attributes = attributes,
-        .flags = flags
+        .flags = flags,
+        .backing = std::move(backing)
     };
     return ScopedMapping(*this, map.start, pages);
 }
@@ -141,7 +154,6 @@ void Mappings::erase(vaddr_t address, size_t pages) {
 }
 
 void Mappings::clear() noexcept {
-    erase(0, numPages(MMAP_STACK_END));
     _maps.clear();
 }
 
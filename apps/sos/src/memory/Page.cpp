@@ -9,6 +9,7 @@ extern "C" {
 #include "internal/memory/FrameTable.h"
 #include "internal/memory/Page.h"
 #include "internal/memory/Swap.h"
+#include "internal/ObjectCache.h"
 
 namespace memory {
 
@@ -26,6 +27,17 @@ Page::Page(FrameTable::Frame& frame):
     frame.insert(*this);
 }
 
+Page::Page(FrameTable::Frame& frame, seL4_ARM_Page cap):
+    Page()
+{
+    assert(frame._pages == nullptr);
+    assert(cap != 0);
+
+    _resident.cap = cap;
+    _status = Status::UNMAPPED;
+    frame.insert(*this);
+}
+
 Page::Page(paddr_t address):
     Page()
 {
@@ -56,13 +68,15 @@ Page::~Page() {
             assert(false);
 
         case Status::UNMAPPED:
-            assert(cspace_delete_cap(cur_cspace, _resident.cap) == CSPACE_NOERROR);
-
+            // The frame takes over our cap if we're its last copy
             if (_resident.frame)
                 _resident.frame->erase(*this);
             else
                 assert(!_prev && !_next);
 
+            if (_resident.cap)
+                SlotCache::get().remove(_resident.cap);
+
             break;
 
         case Status::SWAPPED:
@@ -85,14 +99,17 @@ Page::Page(const Page& other):
         case Status::REFERENCED:
         case Status::UNREFERENCED:
         case Status::UNMAPPED:
-            _resident.cap = cspace_copy_cap(cur_cspace, cur_cspace, other._resident.cap, seL4_AllRights);
+            _resident.cap = SlotCache::get().copy(other._resident.cap);
             if (_resident.cap == CSPACE_NULL)
                 throw std::system_error(ENOMEM, std::system_category(), "Failed to copy page cap");
             assert(_resident.cap != 0);
 
             _status = Status::UNMAPPED;
-            assert(other._resident.frame); // Non-frame pages cannot be copied
-            other._resident.frame->insert(*this);
+
+            // Device pages aren't in the frame table, so there's nothing to
+            // keep track of
+            if (other._resident.frame)
+                other._resident.frame->insert(*this);
             break;
 
         case Status::SWAPPED:
@@ -101,6 +118,37 @@ Page::Page(const Page& other):
     }
 }
 
+uint8_t* Page::getWindowAddress() const {
+    switch (_status) {
+        case Status::LOCKED:
+        case Status::REFERENCED:
+        case Status::UNREFERENCED:
+        case Status::UNMAPPED:
+            break;
+
+        default:
+            assert(false);
+    }
+
+    assert(_resident.frame); // Non-frame pages are not in the window
+    return _resident.frame->getWindowAddress();
+}
+
+const FrameTable::Frame* Page::getFrame() const {
+    switch (_status) {
+        case Status::LOCKED:
+        case Status::REFERENCED:
+        case Status::UNREFERENCED:
+        case Status::UNMAPPED:
+            break;
+
+        default:
+            assert(false);
+    }
+
+    return _resident.frame;
+}
+
 Page::Page(Page&& other) noexcept:
     Page()
 {
@@ -43,28 +43,41 @@ size_t PageDirectory::countPages() const noexcept {
 
 void PageDirectory::reservePages(vaddr_t from, vaddr_t to) {
     from = pageTableAlign(from);
-    for (vaddr_t address = from; address < to; address += PAGE_TABLE_SIZE) {
-        auto table = _tables.find(_toIndex(address));
-        if (table == _tables.end()) {
-            table = _tables.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(_toIndex(address)),
-                std::forward_as_tuple(*this, _toIndex(address))
-            ).first;
-        }
+    for (vaddr_t address = from; address < to; address += PAGE_TABLE_SIZE)
+        _getTable(address).reservePages();
+}
 
-        table->second.reservePages();
-    }
+void PageDirectory::reservePageTable(vaddr_t address) {
+    _getTable(address);
 }
 
-async::future<const MappedPage&> PageDirectory::makeResident(vaddr_t address, Attributes attributes) {
+async::future<const MappedPage&> PageDirectory::makeResident(vaddr_t address, Attributes attributes, FaultType* type, int nice) {
+    FaultType ignoredType;
+    if (!type)
+        type = &ignoredType;
+    *type = FaultType::MINOR;
+
+    auto pending = _pendingFaults.find(address);
+    if (pending != _pendingFaults.end()) {
+        // Whether or not that worked, this fault starts over
+        pending->second.emplace_back();
+        return pending->second.back().get_future().then([=](async::future<void> result) {
+            (void)result;
+            return this->makeResident(address, attributes, nullptr, nice);
+        }).unwrap();
+    }
+
     auto table = _tables.find(_toIndex(address));
-    if (table == _tables.end())
-        return allocateAndMap(address, attributes);
+    if (table == _tables.end()) {
+        *type = FaultType::ZERO_FILL;
+        return allocateAndMap(address, attributes, nice);
+    }
 
     MappedPage* page = table->second.lookup(address, true);
-    if (!page)
-        return allocateAndMap(address, attributes);
+    if (!page) {
+        *type = FaultType::ZERO_FILL;
+        return allocateAndMap(address, attributes, nice);
+    }
 
     if (page->getAttributes() != attributes)
         throw std::system_error(ENOSYS, std::system_category(), "Changing page attributes not implemented");
@@ -83,33 +96,31 @@ async::future<const MappedPage&> PageDirectory::makeResident(vaddr_t address, At
             break;
 
         case memory::Page::Status::SWAPPED:
-            return page->swapIn().then([=](async::future<void> result) -> const MappedPage& {
+            *type = FaultType::SWAP_IN;
+            return _addPendingFault(address, page->swapIn(nice).then([=](async::future<void> result) -> const MappedPage& {
                 result.get();
                 page->enableReference(*this);
                 return *page;
-            });
+            }));
     }
 
     return async::make_ready_future<const MappedPage&>(static_cast<const MappedPage&>(*page));
 }
 
-async::future<const MappedPage&> PageDirectory::allocateAndMap(vaddr_t address, Attributes attributes) {
-    return FrameTable::alloc().then([=] (auto page) -> const MappedPage& {
-        return this->map(page.get(), address, attributes);
-    });
+async::future<const MappedPage&> PageDirectory::allocateAndMap(vaddr_t address, Attributes attributes, int nice) {
+    return _addPendingFault(address, FrameTable::alloc(nice).then([=] (auto page) -> const MappedPage& {
+        auto _page = page.get();
+
+        // Something else might have mapped it in the meantime, in which case
+        // the new page is just dropped
+        if (const MappedPage* existing = this->lookup(address, true))
+            return *existing;
+        return this->map(std::move(_page), address, attributes);
+    }));
 }
 
 const MappedPage& PageDirectory::map(Page page, vaddr_t address, Attributes attributes) {
-    auto table = _tables.find(_toIndex(address));
-    if (table == _tables.end()) {
-        table = _tables.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(_toIndex(address)),
-            std::forward_as_tuple(*this, _toIndex(address))
-        ).first;
-    }
-
-    return table->second.map(std::move(page), address, attributes);
+    return _getTable(address).map(std::move(page), address, attributes);
 }
 
 void PageDirectory::unmap(vaddr_t address) noexcept {
@@ -124,6 +135,21 @@ void PageDirectory::clear() noexcept {
     _tables.clear();
 }
 
+bool PageDirectory::clearSome(size_t maxPages) noexcept {
+    while (!_tables.empty()) {
+        auto table = _tables.begin();
+        maxPages -= table->second.clearSome(maxPages);
+        if (table->second.countPages() > 0)
+            return false;
+
+        _tables.erase(table);
+        if (maxPages == 0)
+            return _tables.empty();
+    }
+
+    return true;
+}
+
 const MappedPage* PageDirectory::lookup(vaddr_t address, bool noThrow) const {
     auto table = _tables.find(_toIndex(address));
     if (table == _tables.end()) {
@@ -135,6 +161,37 @@ const MappedPage* PageDirectory::lookup(vaddr_t address, bool noThrow) const {
     return table->second.lookup(address, noThrow);
 }
 
+async::future<const MappedPage&> PageDirectory::_addPendingFault(vaddr_t address, async::future<const MappedPage&> fault) {
+    if (fault.is_ready())
+        return fault;
+
+    _pendingFaults[address];
+    return fault.then([this, address](auto page) -> const MappedPage& {
+        auto pending = _pendingFaults.find(address);
+        if (pending != _pendingFaults.end()) {
+            auto waiters = std::move(pending->second);
+            _pendingFaults.erase(pending);
+            for (auto& waiter : waiters)
+                waiter.set_value();
+        }
+
+        return page.get();
+    });
+}
+
+PageTable& PageDirectory::_getTable(vaddr_t address) {
+    auto table = _tables.find(_toIndex(address));
+    if (table == _tables.end()) {
+        table = _tables.emplace(
+            std::piecewise_construct,
+            std::forward_as_tuple(_toIndex(address)),
+            std::forward_as_tuple(*this, _toIndex(address))
+        ).first;
+    }
+
+    return table->second;
+}
+
 ///////////////
 // PageTable //
 ///////////////
@@ -192,6 +249,16 @@ void PageTable::unmap(vaddr_t address) noexcept {
     _pages.erase(_toIndex(address));
 }
 
+size_t PageTable::clearSome(size_t maxPages) noexcept {
+    size_t pages = 0;
+    while (pages < maxPages && !_pages.empty()) {
+        _pages.erase(_pages.begin());
+        ++pages;
+    }
+
+    return pages;
+}
+
 MappedPage* PageTable::lookup(vaddr_t address, bool noThrow) {
     return const_cast<MappedPage*>(static_cast<const PageTable*>(this)->lookup(address, noThrow));
 }
@@ -246,9 +313,9 @@ void MappedPage::enableReference(PageDirectory& directory) {
         _page._resident.frame->updateStatus();
 }
 
-async::future<void> MappedPage::swapIn() {
+async::future<void> MappedPage::swapIn(int nice) {
     assert(_page._status == Page::Status::SWAPPED);
-    return Swap::get().swapIn(_page);
+    return Swap::get().swapIn(_page, nice);
 }
 
 seL4_CapRights MappedPage::seL4Rights() const {
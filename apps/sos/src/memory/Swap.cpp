@@ -11,6 +11,7 @@ extern "C" {
 #include "internal/memory/Swap.h"
 #include "internal/memory/UserMemory.h"
 #include "internal/process/Thread.h"
+#include "internal/ObjectCache.h"
 
 namespace memory {
 
@@ -30,22 +31,6 @@ Swap::Swap():
             .buffer = UserMemory(process::getSosProcess(), _swapOutBufferMapping.getAddress()),
             .length = PAGE_SIZE
         }
-    }),
-    _swapInBufferMapping(process::getSosProcess()->maps.insert(
-        0, 1,
-        Attributes{
-            .read = false,
-            .write = true,
-            .execute = false,
-            .locked = true
-        },
-        Mapping::Flags{.shared = false}
-    )),
-    _swapInBufferIoVectors({
-        fs::IoVector{
-            .buffer = UserMemory(process::getSosProcess(), _swapInBufferMapping.getAddress()),
-            .length = PAGE_SIZE
-        }
     })
 {}
 
@@ -59,12 +44,12 @@ void Swap::addBackingStore(std::shared_ptr<fs::File> store, size_t size) {
     _usedBitset.resize(numPages(size));
 }
 
-async::future<void> Swap::swapOut(FrameTable::Frame& frame) {
+async::future<void> Swap::swapOut(FrameTable::Frame& frame, int nice) {
     if (!_store)
         throw std::bad_alloc();
 
     auto promise = std::make_shared<async::promise<void>>();
-    _pendingSwapOuts.push([=, &frame]() noexcept {
+    _pendingSwapOuts.push(PendingSwapOut{nice, _nextSequence++, [=, &frame]() noexcept {
         assert(frame._pages);
         assert(!frame._isLocked);
         assert(!frame._isReferenced);
@@ -94,19 +79,29 @@ async::future<void> Swap::swapOut(FrameTable::Frame& frame) {
                             throw;
                         }
 
+                        // Delete the caps of all the copies together
+                        size_t copies = 0;
+                        for (Page* page = frame._pages; page != nullptr; page = page->_next)
+                            ++copies;
+                        std::vector<seL4_CPtr> caps(copies);
+
+                        size_t c = 0;
                         for (Page* page = frame._pages; page != nullptr; page = page->_next) {
                             assert(page->_status == Page::Status::UNREFERENCED);
                             assert(page->_resident.frame == &frame);
 
-                            assert(cspace_delete_cap(cur_cspace, page->_resident.cap) == CSPACE_NOERROR);
-
+                            caps[c++] = page->_resident.cap;
                             page->_status = Page::Status::SWAPPED;
                             page->_swapId = id;
                         }
+                        SlotCache::get().remove(caps.size(), caps.data());
 
+                        frame._unmapWindow();
                         ut_free(frame.getAddress(), seL4_PageBits);
                         frame._pages = nullptr;
-                    }).then([=](async::future<void> result) noexcept {
+                    }).then([=, &frame](async::future<void> result) noexcept {
+                        frame._isSwappingOut = false;
+
                         try {
                             result.get();
                             promise->set_value();
@@ -114,9 +109,7 @@ async::future<void> Swap::swapOut(FrameTable::Frame& frame) {
                             promise->set_exception(std::current_exception());
                         }
 
-                        _pendingSwapOuts.pop();
-                        if (!_pendingSwapOuts.empty())
-                            _pendingSwapOuts.front()();
+                        _finishSwapOut();
                     });
                 } catch (...) {
                     process::getSosProcess()->pageDirectory.unmap(_swapOutBufferMapping.getAddress());
@@ -127,21 +120,44 @@ async::future<void> Swap::swapOut(FrameTable::Frame& frame) {
                 throw;
             }
         } catch (...) {
+            frame._isSwappingOut = false;
             promise->set_exception(std::current_exception());
 
-            _pendingSwapOuts.pop();
-            if (!_pendingSwapOuts.empty())
-                _pendingSwapOuts.front()();
+            _finishSwapOut();
         }
-    });
+    }});
 
-    if (_pendingSwapOuts.size() == 1)
-        _pendingSwapOuts.front()();
+    if (!_isSwappingOut) {
+        _isSwappingOut = true;
+        _startNextSwapOut();
+    }
 
     return promise->get_future();
 }
 
-async::future<void> Swap::swapIn(const Page& page) {
+void Swap::_startNextSwapOut() {
+    // Only one at a time, since they share the buffer mapping
+    auto start = _pendingSwapOuts.top().start;
+    _pendingSwapOuts.pop();
+    start();
+}
+
+void Swap::_finishSwapOut() {
+    if (_pendingSwapOuts.empty()) {
+        _isSwappingOut = false;
+        return;
+    }
+
+    // Start the next one from the main loop rather than from inside the
+    // completion of the last one, so a long queue doesn't build up a deep
+    // stack. Every swap out has a faulting thread waiting on it, so this
+    // isn't background work
+    async::RunQueue::get().post(async::RunQueue::Priority::NORMAL, [this] {
+        _startNextSwapOut();
+    });
+}
+
+async::future<void> Swap::swapIn(const Page& page, int nice) {
     if (!_store)
         throw std::bad_alloc();
 
@@ -149,108 +165,100 @@ async::future<void> Swap::swapIn(const Page& page) {
     assert(_usedBitset[page._swapId]);
 
     auto targetPage = std::make_shared<Page>(page.copy());
-    auto promise = std::make_shared<async::promise<void>>();
 
-    _pendingSwapIns.push([this, targetPage, promise]() noexcept {
-        FrameTable::alloc().then([=](auto bufferPage) {
-            Page _bufferPage = std::move(bufferPage.get());
-            seL4_Word bufferPageCap = _bufferPage.getCap();
-            FrameTable::Frame& bufferFrame = *_bufferPage._resident.frame;
-
-            try {
-                Attributes attributes = {0};
-                attributes.read = true;
-                attributes.write = true;
-                attributes.locked = true;
-                process::getSosProcess()->pageDirectory.map(
-                    std::move(_bufferPage),
-                    _swapInBufferMapping.getAddress(),
-                    attributes
-                );
-
-                try {
-                    _store->read(_swapInBufferIoVectors, targetPage->_swapId * PAGE_SIZE)
-                        .then([=, &bufferFrame](auto read) {
-                            try {
-                                if (static_cast<size_t>(read.get()) != PAGE_SIZE)
-                                    throw std::bad_alloc();
-                            } catch (...) {
-                                process::getSosProcess()->pageDirectory.unmap(_swapInBufferMapping.getAddress());
-                                throw;
-                            }
-
-                            Page* head = targetPage.get();
-                            while (head->_prev)
-                                head = head->_prev;
-
-                            SwapId id = targetPage->_swapId;
-
-                            for (Page* page = head; page != nullptr; page = page->_next) {
-                                assert(page->_status == Page::Status::SWAPPED);
-                                assert(page->_swapId == id);
-
-                                page->_resident.cap = cspace_copy_cap(cur_cspace, cur_cspace, bufferPageCap, seL4_AllRights);
-                                if (page->_resident.cap == CSPACE_NULL) {
-                                    // Rollback
-                                    page->_swapId = id;
-                                    for (page = page->_prev; page != nullptr; page = page->_prev) {
-                                        assert(cspace_delete_cap(cur_cspace, page->_resident.cap) == CSPACE_NOERROR);
-                                        page->_status = Page::Status::SWAPPED;
-                                        page->_swapId = id;
-                                    }
-
-                                    process::getSosProcess()->pageDirectory.unmap(_swapInBufferMapping.getAddress());
-                                    throw std::system_error(ENOMEM, std::system_category(), "Failed to copy page cap");
-                                }
-                                assert(page->_resident.cap != 0);
-
-                                page->_status = Page::Status::UNREFERENCED;
-                                page->_resident.frame = &bufferFrame;
-                            }
-
-                            assert(!bufferFrame._pages->_next);
-                            bufferFrame._pages->_next = head;
-                            head->_prev = bufferFrame._pages;
-
-                            assert(seL4_ARM_Page_Unify_Instruction(
-                                bufferPageCap,
-                                0, PAGE_SIZE
-                            ) == seL4_NoError);
-
-                            process::getSosProcess()->pageDirectory.unmap(_swapInBufferMapping.getAddress());
-                            this->_free(id);
-
-                            targetPage->_status = Page::Status::UNMAPPED;
-                        }).then([=](async::future<void> result) noexcept {
-                            try {
-                                result.get();
-                                promise->set_value();
-                            } catch (...) {
-                                promise->set_exception(std::current_exception());
-                            }
-
-                            _pendingSwapIns.pop();
-                            if (!_pendingSwapIns.empty())
-                                _pendingSwapIns.front()();
-                        });
-                } catch (...) {
-                    process::getSosProcess()->pageDirectory.unmap(_swapInBufferMapping.getAddress());
-                    throw;
-                }
-            } catch (...) {
-                promise->set_exception(std::current_exception());
+    // Copies of the page in other processes share the swap slot, and the
+    // first swap in brings all of them in. Wait for it, and try again if it
+    // didn't work out
+    SwapId id = page._swapId;
+    auto pending = _pendingSwapIns.find(id);
+    if (pending != _pendingSwapIns.end()) {
+        pending->second.emplace_back();
+        return pending->second.back().get_future().then([this, targetPage, nice](async::future<void> result) {
+            (void)result;
+            if (targetPage->_status == Page::Status::SWAPPED)
+                return this->swapIn(*targetPage, nice);
+            return async::make_ready_future();
+        }).unwrap();
+    }
 
-                _pendingSwapIns.pop();
-                if (!_pendingSwapIns.empty())
-                    _pendingSwapIns.front()();
+    // Each swap in reads straight into its new frame through the frame
+    // window, so unlike swap outs they don't need to wait for each other
+    auto future = FrameTable::alloc(nice).then([this, targetPage](auto bufferPage) {
+        // Keep the buffer page unmapped until we're done, so the new frame
+        // stays locked
+        auto _bufferPage = std::make_shared<Page>(std::move(bufferPage.get()));
+        FrameTable::Frame& bufferFrame = *_bufferPage->_resident.frame;
+
+        std::vector<fs::IoVector> iov = {
+            fs::IoVector{
+                .buffer = UserMemory(
+                    process::getSosProcess(),
+                    reinterpret_cast<vaddr_t>(bufferFrame.getWindowAddress())
+                ),
+                .length = PAGE_SIZE
             }
-        });
-    });
+        };
+
+        return _store->read(iov, targetPage->_swapId * PAGE_SIZE)
+            .then([this, targetPage, _bufferPage, &bufferFrame](auto read) {
+                if (static_cast<size_t>(read.get()) != PAGE_SIZE)
+                    throw std::bad_alloc();
+
+                seL4_Word bufferPageCap = _bufferPage->getCap();
+
+                Page* head = targetPage.get();
+                while (head->_prev)
+                    head = head->_prev;
+
+                SwapId id = targetPage->_swapId;
+
+                // Every copy of the page needs its own cap, so make them all
+                // at once
+                size_t copies = 0;
+                for (Page* page = head; page != nullptr; page = page->_next)
+                    ++copies;
+                std::vector<seL4_CPtr> caps(copies);
+                if (!SlotCache::get().copy(bufferPageCap, copies, caps.data()))
+                    throw std::system_error(ENOMEM, std::system_category(), "Failed to copy page cap");
+
+                size_t c = 0;
+                for (Page* page = head; page != nullptr; page = page->_next) {
+                    assert(page->_status == Page::Status::SWAPPED);
+                    assert(page->_swapId == id);
+                    assert(caps[c] != 0);
+
+                    page->_resident.cap = caps[c++];
+                    page->_status = Page::Status::UNREFERENCED;
+                    page->_resident.frame = &bufferFrame;
+                }
 
-    if (_pendingSwapIns.size() == 1)
-        _pendingSwapIns.front()();
+                assert(!bufferFrame._pages->_next);
+                bufferFrame._pages->_next = head;
+                head->_prev = bufferFrame._pages;
+
+                assert(seL4_ARM_Page_Unify_Instruction(
+                    bufferPageCap,
+                    0, PAGE_SIZE
+                ) == seL4_NoError);
+
+                this->_free(id);
+
+                targetPage->_status = Page::Status::UNMAPPED;
+            });
+    }).unwrap();
+
+    _pendingSwapIns[id];
+    return future.then([this, id](async::future<void> result) {
+        auto pending = _pendingSwapIns.find(id);
+        if (pending != _pendingSwapIns.end()) {
+            auto waiters = std::move(pending->second);
+            _pendingSwapIns.erase(pending);
+            for (auto& waiter : waiters)
+                waiter.set_value();
+        }
 
-    return promise->get_future();
+        result.get();
+    });
 }
 
 void Swap::copy(const Page& from, Page& to) noexcept {
@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
 #include <system_error>
 #include <limits.h>
 
@@ -7,33 +10,69 @@
 
 namespace memory {
 
+namespace {
+    // Nearly every path based syscall reads a string of up to PATH_MAX, and
+    // the buffer has to outlive the copy, so keep a few of them around rather
+    // than allocating a new one each time
+    constexpr const size_t SPARE_STRING_BUFFERS = 4;
+    std::array<std::unique_ptr<char[]>, SPARE_STRING_BUFFERS> _spareStringBuffers;
+    size_t _spareStringBufferCount = 0;
+
+    char* _takeStringBuffer(size_t size) {
+        if (size == PATH_MAX && _spareStringBufferCount > 0)
+            return _spareStringBuffers[--_spareStringBufferCount].release();
+        return new char[size];
+    }
+
+    void _giveStringBuffer(char* buffer, size_t size) noexcept {
+        if (size == PATH_MAX && _spareStringBufferCount < SPARE_STRING_BUFFERS)
+            _spareStringBuffers[_spareStringBufferCount++].reset(buffer);
+        else
+            delete[] buffer;
+    }
+}
+
 UserMemory::UserMemory(std::weak_ptr<process::Process> process, vaddr_t address):
     _process(process),
     _address(address)
 {}
 
-async::future<std::string> UserMemory::readString(bool bypassAttributes) {
-    // Map in one page
-    return mapIn<char>(1, Attributes{.read = true}, bypassAttributes)
-        .then([_process = _process, _address = _address, bypassAttributes](auto map) {
-            auto map_ = std::move(map.get());
-
-            // Read until end of string or page
-            std::string string;
-            char* pageEnd = reinterpret_cast<char*>(map_.second.getEnd());
-            for (char* c = map_.first; c < pageEnd; ++c)
-                if (*c)
-                    string.push_back(*c);
-                else
-                    return async::make_ready_future(string);
-
-            // Continue reading from next page
-            return UserMemory(_process, map_.second.getEnd())
-                .readString(bypassAttributes)
-                .then([string](auto result) {
-                    return string + result.get();
-                });
-        });
+async::future<size_t> UserMemory::readString(char* buffer, size_t size, bool bypassAttributes) {
+    if (size == 0)
+        throw std::invalid_argument("Buffer must have space for the NUL terminator");
+
+    return _copy(reinterpret_cast<uint8_t*>(buffer), size, false, true, bypassAttributes)
+        .then([buffer](auto copied) {
+            size_t copied_ = copied.get();
+            if (buffer[copied_ - 1] != '\0')
+                throw std::system_error(ENAMETOOLONG, std::system_category(), "String is too long");
+
+            return copied_ - 1;
+        }).toBoostFuture();
+}
+
+async::future<std::string> UserMemory::readString(bool bypassAttributes, size_t maxLength) {
+    size_t size = maxLength + 1;
+    char* buffer = _takeStringBuffer(size);
+
+    async::future<size_t> length;
+    try {
+        length = readString(buffer, size, bypassAttributes);
+    } catch (...) {
+        _giveStringBuffer(buffer, size);
+        throw;
+    }
+
+    return length.then([buffer, size](auto length) {
+        try {
+            std::string result(buffer, length.get());
+            _giveStringBuffer(buffer, size);
+            return result;
+        } catch (...) {
+            _giveStringBuffer(buffer, size);
+            throw;
+        }
+    });
 }
 
 async::future<std::pair<uint8_t*, ScopedMapping>> UserMemory::_mapIn(size_t bytes, Attributes attributes, bool bypassAttributes) try {
@@ -61,9 +100,14 @@ async::future<std::pair<uint8_t*, ScopedMapping>> UserMemory::_mapIn(size_t byte
             Mapping::Flags{.shared = false}
         ));
 
-        async::promise<void> promise;
-        promise.set_value();
-        auto future = promise.get_future();
+        // Fault everything in concurrently first. The pages still need to be
+        // faulted in again one by one below, since they aren't locked until
+        // they're mapped into SOS, but that will usually be immediate
+        auto future = process->pageFaultMultiple(
+            alignedAddress, pages,
+            bypassAttributes ? Attributes{} : attributes,
+            nullptr
+        );
 
         for (size_t p = 0; p < pages; ++p) {
             vaddr_t srcAddr = alignedAddress + p * PAGE_SIZE;
@@ -101,4 +145,95 @@ async::future<std::pair<uint8_t*, ScopedMapping>> UserMemory::_mapIn(size_t byte
     std::throw_with_nested(std::system_error(EFAULT, std::system_category(), "Failed to map in user memory"));
 }
 
+uint8_t* UserMemory::_tryTranslate(vaddr_t address, Attributes attributes, bool bypassAttributes) const {
+    std::shared_ptr<process::Process> process(_process);
+    vaddr_t alignedAddress = pageAlign(address);
+
+    if (process->isSosProcess) {
+        // XXX: Same as in _mapIn(), we just assume SOS' mappings are read+write
+        (void)process->maps.lookup(alignedAddress);
+        return reinterpret_cast<uint8_t*>(address);
+    }
+
+    (void)process->checkAccess(alignedAddress, bypassAttributes ? Attributes{} : attributes);
+
+    const MappedPage* page = process->pageDirectory.lookup(alignedAddress, true);
+    if (!page)
+        return nullptr;
+
+    switch (page->getPage().getStatus()) {
+        case Page::Status::LOCKED:
+        case Page::Status::REFERENCED:
+            return page->getPage().getWindowAddress() + pageOffset(address);
+
+        default:
+            return nullptr;
+    }
+}
+
+size_t UserMemory::_tryCopy(uint8_t* buffer, size_t bytes, size_t copied, bool isWrite, bool isString, bool bypassAttributes) const {
+    Attributes attributes = isWrite ? Attributes{.read = false, .write = true} : Attributes{.read = true};
+
+    while (copied < bytes) {
+        vaddr_t address = _address + copied;
+        uint8_t* user = _tryTranslate(address, attributes, bypassAttributes);
+        if (!user)
+            break;
+
+        size_t pageBytes = std::min(bytes - copied, PAGE_SIZE - pageOffset(address));
+        if (isWrite) {
+            std::copy(buffer + copied, buffer + copied + pageBytes, user);
+        } else if (isString) {
+            uint8_t* end = std::find(user, user + pageBytes, '\0');
+            if (end != user + pageBytes) {
+                std::copy(user, end + 1, buffer + copied);
+                return copied + (end - user) + 1;
+            }
+            std::copy(user, end, buffer + copied);
+        } else {
+            std::copy(user, user + pageBytes, buffer + copied);
+        }
+
+        copied += pageBytes;
+    }
+
+    return copied;
+}
+
+async::Future<size_t> UserMemory::_copy(uint8_t* buffer, size_t bytes, bool isWrite, bool isString, bool bypassAttributes, size_t copied) const try {
+    if (_address + bytes < _address)
+        throw std::invalid_argument("Address range overflows");
+
+    copied = _tryCopy(buffer, bytes, copied, isWrite, isString, bypassAttributes);
+    if (copied == bytes || (isString && copied > 0 && buffer[copied - 1] == '\0'))
+        return async::makeReadyFuture(copied);
+
+    // Fault in the page that stopped us, then continue from there. Strings
+    // could end before the rest of the range, so only they can't fault in
+    // everything that's left at once
+    std::shared_ptr<process::Process> process(_process);
+    vaddr_t address = pageAlign(_address + copied);
+    Attributes attributes = isWrite ? Attributes{.read = false, .write = true} : Attributes{.read = true};
+    if (bypassAttributes)
+        attributes = Attributes{};
+
+    async::future<void> future;
+    if (isString)
+        future = process->handlePageFault(address, attributes);
+    else
+        future = process->pageFaultMultiple(address, numPages(_address + bytes - address), attributes, nullptr);
+
+    return async::Future<void>(std::move(future)).then([self = *this, buffer, bytes, isWrite, isString, bypassAttributes, copied](async::Future<void> result) {
+            try {
+                result.get();
+            } catch (const std::invalid_argument& e) {
+                std::throw_with_nested(std::system_error(EFAULT, std::system_category(), "Failed to access user memory"));
+            }
+
+            return self._copy(buffer, bytes, isWrite, isString, bypassAttributes, copied);
+        }).unwrap();
+} catch (const std::invalid_argument& e) {
+    std::throw_with_nested(std::system_error(EFAULT, std::system_category(), "Failed to access user memory"));
+}
+
 }
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <utility>
+
+extern "C" {
+    #include <autoconf.h>
+}
+
+#include "internal/async.h"
+#include "internal/process/Reaper.h"
+
+namespace process {
+
+void Reaper::add(std::shared_ptr<Process> process) {
+    if (process->_isReaped)
+        return;
+    process->_isReaped = true;
+
+    // Nothing can be faulted in any more, so the mappings can go straight
+    // away. What they map is what takes the time
+    process->fdTable.clear();
+    process->maps.clear();
+
+    _processes.push_back(std::move(process));
+    _queueStep();
+}
+
+void Reaper::add(std::shared_ptr<Process> process, memory::ScopedMapping mapping) {
+    _ranges.push_back(Range{process, mapping.getStart(), mapping.getPages(), 0});
+    mapping.release();
+    _queueStep();
+}
+
+void Reaper::_queueStep() {
+    if (_isStepQueued)
+        return;
+
+    async::RunQueue::get().post(async::RunQueue::Priority::BACKGROUND, [this] {
+        _step();
+    });
+    _isStepQueued = true;
+}
+
+void Reaper::_step() noexcept {
+    _isStepQueued = false;
+
+    // Destroying the process might add more (such as its zombie children),
+    // so take it off the queue first
+    std::shared_ptr<Process> finished;
+    if (!_processes.empty()) {
+        if (_processes.front()->pageDirectory.clearSome(CONFIG_SOS_REAPER_BUDGET)) {
+            finished = std::move(_processes.front());
+            _processes.pop_front();
+        }
+    } else {
+        _stepRange();
+    }
+
+    if (!_processes.empty() || !_ranges.empty())
+        _queueStep();
+}
+
+void Reaper::_stepRange() noexcept {
+    Range& range = _ranges.front();
+
+    // Once the whole process is being torn down, its pages go with it
+    auto process = range.process.lock();
+    if (!process || process->_isReaped) {
+        _ranges.pop_front();
+        return;
+    }
+
+    size_t pages = std::min<size_t>(range.pages - range.unmappedPages, CONFIG_SOS_REAPER_BUDGET);
+    for (size_t p = 0; p < pages; ++p)
+        process->pageDirectory.unmap(range.start + (range.unmappedPages + p) * PAGE_SIZE);
+    range.unmappedPages += pages;
+
+    if (range.unmappedPages == range.pages) {
+        process->maps.erase(range.start, range.pages);
+        _ranges.pop_front();
+    }
+}
+
+Reaper& Reaper::get() noexcept {
+    static Reaper reaper;
+    return reaper;
+}
+
+}
@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <string>
 #include <stdexcept>
 #include <system_error>
+#include <vector>
 
 #include <assert.h>
 #include <errno.h>
 
 extern "C" {
+    #include <autoconf.h>
     #include <sos.h>
     #include <sel4/sel4.h>
 
@@ -14,12 +17,25 @@ extern "C" {
 
 #include "internal/async.h"
 #include "internal/memory/layout.h"
+#include "internal/memory/UserMemory.h"
+#include "internal/process/Reaper.h"
 #include "internal/process/Thread.h"
+#include "internal/syscall/futex.h"
+#include "internal/syscall/ring.h"
 #include "internal/syscall/syscall.h"
 #include "internal/process/Table.h"
+#include "internal/stats.h"
 
 namespace process {
 
+namespace {
+    // Always below SOS, which stays at seL4_MaxPrio so faults and syscalls
+    // are handled as soon as they come in
+    seL4_Uint8 _getPriority(int nice) noexcept {
+        return seL4_MaxPrio - 1 - (nice - MIN_NICE);
+    }
+}
+
 ////////////
 // Thread //
 ////////////
@@ -27,6 +43,9 @@ namespace process {
 Thread::Thread(std::shared_ptr<Process> process):
     _status(Status::CREATED),
     _process(process),
+
+    // Create a simple 1 level CSpace
+    _cspace(cspace_create(1), [](cspace_t* cspace) {assert(cspace_destroy(cspace) == CSPACE_NOERROR);}),
     _faultEndpoint(0),
     _stack(_process->maps.insert(
         0, memory::STACK_PAGES,
@@ -44,13 +63,16 @@ Thread::Thread(std::shared_ptr<Process> process):
         memory::Mapping::Flags{.shared = false}
     ))
 {
+    if (!_cspace)
+        throw std::system_error(ENOMEM, std::system_category(), "Failed to create CSpace");
+
     kprintf(LOGLEVEL_DEBUG, "<Process %p>::<Thread %p> Created\n", process.get(), this);
 }
 
 Thread::~Thread() {
     // Free the fault endpoint if valid
     if (_status == Status::STARTED)
-        assert(cspace_delete_cap(_process->_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
+        assert(cspace_delete_cap(_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
 
     // C++17: _process->_threads.erase(weak_from_this());
     for (auto thread = _process->_threads.begin(); thread != _process->_threads.end(); ++thread) {
@@ -60,6 +82,11 @@ Thread::~Thread() {
         }
     }
 
+    // Nothing can be running in the process any more, so the rest of it can
+    // be torn down
+    if (_process->_isZombie)
+        Reaper::get().add(_process);
+
     if (_status == Status::CREATED)
         kprintf(LOGLEVEL_DEBUG, "<Process %p>::<Thread %p> Destroyed\n", _process.get(), this);
     else
@@ -70,7 +97,10 @@ async::future<void> Thread::start(
     pid_t tid,
     const Capability<seL4_EndpointObject, seL4_EndpointBits>& faultEndpoint,
     seL4_Word faultEndpointBadge,
-    memory::vaddr_t entryPoint
+    memory::vaddr_t entryPoint,
+    memory::vaddr_t stackPointer,
+    seL4_Word argument,
+    seL4_Word threadPointer
 ) {
     if (_status != Status::CREATED)
         throw std::logic_error("Thread already started once");
@@ -85,10 +115,11 @@ async::future<void> Thread::start(
         }
     ).then([=, &faultEndpoint](auto page) {
         const memory::MappedPage& ipcBufferMappedPage = page.get();
+        reinterpret_cast<seL4_IPCBuffer*>(ipcBufferMappedPage.getPage().getWindowAddress())->userData = threadPointer;
 
         // Copy the fault endpoint to the user app to allow IPC
         _faultEndpoint = cspace_mint_cap(
-            _process->_cspace.get(), cur_cspace,
+            _cspace.get(), cur_cspace,
             faultEndpoint.get(), seL4_AllRights,
             seL4_CapData_Badge_new(faultEndpointBadge)
         );
@@ -98,29 +129,33 @@ async::future<void> Thread::start(
 
         // Configure the TCB
         int err = seL4_TCB_Configure(
-            _tcbCap.get(), _faultEndpoint, 0,
-            _process->_cspace->root_cnode, seL4_NilData,
+            _tcbCap.get(), _faultEndpoint, _getPriority(_process->_nice),
+            _cspace->root_cnode, seL4_NilData,
             _process->pageDirectory.getCap(), seL4_NilData,
             ipcBufferMappedPage.getAddress(), ipcBufferMappedPage.getPage().getCap()
         );
         if (err != seL4_NoError) {
-            assert(cspace_delete_cap(_process->_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
+            assert(cspace_delete_cap(_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
             throw std::system_error(ENOMEM, std::system_category(), "Failed to configure the TCB: " + std::to_string(err));
         }
 
         // Start the thread
         seL4_UserContext context = {
             .pc = entryPoint,
-            .sp = _stack.getEnd()
+            .sp = stackPointer ? stackPointer : _stack.getEnd(),
+            .cpsr = 0,
+            .r0 = argument
         };
-        err = seL4_TCB_WriteRegisters(_tcbCap.get(), true, 0, 2, &context);
+        err = seL4_TCB_WriteRegisters(_tcbCap.get(), true, 0, 4, &context);
         if (err != seL4_NoError) {
-            assert(cspace_delete_cap(_process->_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
+            assert(cspace_delete_cap(_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
             throw std::system_error(ENOMEM, std::system_category(), "Failed to start the thread: " + std::to_string(err));
         }
 
         _status = Status::STARTED;
         _tid = tid;
+        if (!_process->_pid)
+            _process->_pid = tid;
 
         _startTime = timer::getTimestamp();
 
@@ -128,30 +163,85 @@ async::future<void> Thread::start(
     });
 }
 
+void Thread::updatePriority() noexcept {
+    if (_status != Status::STARTED)
+        return;
+
+    // Can't fail, since the TCB cap is valid while the thread is started and
+    // SOS' own priority is above every nice value's
+    assert(seL4_TCB_SetPriority(_tcbCap.get(), _getPriority(_process->_nice)) == seL4_NoError);
+}
+
 void Thread::kill() noexcept {
     if (_status != Status::STARTED)
         return;
 
     _tcbCap.reset();
-    assert(cspace_delete_cap(_process->_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
-
-    _ipcBuffer.reset();
-    _stack.reset();
+    assert(cspace_delete_cap(_cspace.get(), _faultEndpoint) == CSPACE_NOERROR);
 
     _status = Status::ZOMBIE;
+    syscall::cancelFutexWaits(*this);
+    syscall::cancelRingWait(*this);
+
+    // Taking ourselves out of the thread table might be the last thing
+    // keeping us or the process alive
+    auto self = shared_from_this();
+    auto process = _process;
+
+    bool isLastThread = std::none_of(process->_threads.begin(), process->_threads.end(), [](const auto& thread) {
+        auto _thread = thread.lock();
+        return _thread && _thread->_status == Status::STARTED;
+    });
+    if (!isLastThread) {
+        if (_clearChildTid) {
+            // Wake up whoever is joining the thread, like Linux does
+            std::weak_ptr<Process> weakProcess = process;
+            memory::vaddr_t clearChildTid = _clearChildTid;
+            try {
+                memory::UserMemory(process, clearChildTid).set<pid_t>(0).then([weakProcess, clearChildTid](async::future<void> result) {
+                    result.get();
+                    if (auto _process = weakProcess.lock())
+                        syscall::wakeFutex(*_process, clearChildTid, 1);
+                });
+            } catch (...) {
+                // Nothing to report it to
+            }
+        }
+
+        // Unmapped in the background, like the last thread's are with the
+        // rest of the process
+        Reaper::get().add(process, std::move(_ipcBuffer));
+        Reaper::get().add(process, std::move(_stack));
 
-    // TODO: Only supports single-threaded processes
-    _process->_isZombie = true;
-    std::shared_ptr<Process> parent = _process->_parent.lock();
+        // Only the first thread is left behind as a zombie, for whoever
+        // waits on the process
+        if (_tid != process->getPid())
+            ThreadTable::get().erase(_tid);
+
+        kprintf(LOGLEVEL_DEBUG, "<Process %p>::<Thread %p (%d)> Killed\n", process.get(), this, _tid);
+        return;
+    }
+
+    // Left for the reaper along with the rest of the address space, rather
+    // than unmapping them page by page here
+    _ipcBuffer.release();
+    _stack.release();
+
+    process->_isZombie = true;
+    if (_tid != process->getPid())
+        ThreadTable::get().erase(_tid);
+
+    std::shared_ptr<Process> parent = process->_parent.lock();
     if (parent)
-        parent->emitChildExit(_process);
+        parent->emitChildExit(process);
     else
-        ThreadTable::get().erase(_process->getPid());
+        ThreadTable::get().erase(process->getPid());
 
-    kprintf(LOGLEVEL_DEBUG, "<Process %p>::<Thread %p (%d)> Killed\n", _process.get(), this, _tid);
+    kprintf(LOGLEVEL_DEBUG, "<Process %p>::<Thread %p (%d)> Killed\n", process.get(), this, _tid);
 }
 
-void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
+Reply Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
+    Reply reply = {.isReady = false};
     switch (seL4_MessageInfo_get_label(message)) {
         case seL4_VMFault: {
             memory::vaddr_t pc = seL4_GetMR(0);
@@ -179,8 +269,10 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
                 kprintf(LOGLEVEL_ERR, "Unknown status flag: %02x\n", status);
             }
 
+            timer::Timestamp start = timer::getTimestamp();
+            memory::FaultType type = memory::FaultType::MINOR;
             try {
-                auto result = _process->handlePageFault(address, faultType);
+                auto result = _process->handlePageFault(address, faultType, &type);
 
                 if (_status == Status::ZOMBIE) {
                     if (_process->_isZombie)
@@ -190,23 +282,25 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
 
                 if (result.is_ready()) {
                     result.get();
-                    seL4_MessageInfo_t reply = seL4_MessageInfo_new(0, 0, 0, 0);
-                    seL4_Reply(reply);
+                    stats::recordFault(type, timer::getTimestamp() - start, false);
+                    reply = Reply{.isReady = true, .message = seL4_MessageInfo_new(0, 0, 0, 0)};
                 } else {
                     seL4_CPtr replyCap = cspace_save_reply_cap(cur_cspace);
                     if (replyCap == CSPACE_NULL)
                         throw std::system_error(ENOMEM, std::system_category(), "Failed to save reply cap");
 
                     std::weak_ptr<Thread> thread = shared_from_this();
-                    result.then([=](async::future<void> result) {
+                    async::thenOn(_process->getReplyExecutor(), result, [=](async::future<void> result) {
                         std::shared_ptr<Thread> _thread = thread.lock();
                         if (_thread) {
                             if (_thread->_status != Status::ZOMBIE) {
                                 try {
                                     result.get();
-                                    seL4_MessageInfo_t reply = seL4_MessageInfo_new(0, 0, 0, 0);
-                                    seL4_Send(replyCap, reply);
+                                    stats::recordFault(type, timer::getTimestamp() - start, false);
+                                    _thread->_sendLater(replyCap, Reply{.isReady = true, .message = seL4_MessageInfo_new(0, 0, 0, 0)});
+                                    return;
                                 } catch (const std::exception& e) {
+                                    stats::recordFault(type, timer::getTimestamp() - start, true);
                                     kprintf(LOGLEVEL_DEBUG, "Caught %s\n", e.what());
 
                                     kprintf(LOGLEVEL_NOTICE,
@@ -225,10 +319,11 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
                             }
                         }
 
-                        assert(cspace_free_slot(cur_cspace, replyCap) == CSPACE_NOERROR);
+                        assert(cspace_free_reply_cap(cur_cspace, replyCap) == CSPACE_NOERROR);
                     });
                 }
             } catch (const std::exception& e) {
+                stats::recordFault(type, timer::getTimestamp() - start, true);
                 kprintf(LOGLEVEL_DEBUG, "Caught %s\n", e.what());
 
                 kprintf(LOGLEVEL_NOTICE,
@@ -247,10 +342,15 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
         }
 
         case seL4_NoFault: { // Syscall
+            if (_inlinePayload)
+                _inlinePayload->length = 0;
+
+            long number = seL4_GetMR(0);
+            timer::Timestamp start = timer::getTimestamp();
             try {
                 auto result = syscall::handle(
                     shared_from_this(),
-                    seL4_GetMR(0),
+                    number,
                     seL4_MessageInfo_get_length(message) - 1,
                     &seL4_GetIPCBuffer()->msg[1]
                 );
@@ -262,42 +362,36 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
                 }
 
                 if (result.is_ready()) {
-                    seL4_MessageInfo_t reply = seL4_MessageInfo_new(0, 0, 0, 1);
-                    seL4_SetMR(0, result.get());
-                    seL4_Reply(reply);
+                    reply = _getSyscallReply(number, start, std::move(result));
                 } else {
                     seL4_CPtr replyCap = cspace_save_reply_cap(cur_cspace);
                     if (replyCap == CSPACE_NULL) {
-                        seL4_MessageInfo_t reply = seL4_MessageInfo_new(0, 0, 0, 1);
-                        seL4_SetMR(0, -ENOMEM);
-                        seL4_Reply(reply);
+                        stats::recordSyscall(number, timer::getTimestamp() - start, true);
+                        reply = Reply{
+                            .isReady = true,
+                            .message = seL4_MessageInfo_new(0, 0, 0, 1),
+                            .result = static_cast<seL4_Word>(-ENOMEM)
+                        };
                         break;
                     }
 
                     std::weak_ptr<Thread> thread = shared_from_this();
-                    result.then([replyCap, thread](async::future<int> result) {
+                    async::thenOn(_process->getReplyExecutor(), result, [replyCap, thread, number, start](async::future<int> result) {
                         std::shared_ptr<Thread> _thread = thread.lock();
                         if (_thread) {
                             if (_thread->_status != Status::ZOMBIE) {
-                                seL4_MessageInfo_t reply = seL4_MessageInfo_new(0, 0, 0, 1);
-                                try {
-                                    seL4_SetMR(0, result.get());
-                                } catch (...) {
-                                    seL4_SetMR(0, -syscall::exceptionToErrno(std::current_exception()));
-                                }
-                                seL4_Send(replyCap, reply);
+                                _thread->_sendLater(replyCap, _thread->_getSyscallReply(number, start, std::move(result)));
+                                return;
                             } else if (_thread->_process->_isZombie) {
                                 _thread->_process->_shrinkZombie();
                             }
                         }
 
-                        assert(cspace_free_slot(cur_cspace, replyCap) == CSPACE_NOERROR);
+                        assert(cspace_free_reply_cap(cur_cspace, replyCap) == CSPACE_NOERROR);
                     });
                 }
             } catch (...) {
-                seL4_MessageInfo_t reply = seL4_MessageInfo_new(0, 0, 0, 1);
-                seL4_SetMR(0, -syscall::exceptionToErrno(std::current_exception()));
-                seL4_Reply(reply);
+                reply = _getSyscallReply(number, start, async::make_exceptional_future<int>(std::current_exception()));
             }
             break;
         }
@@ -306,6 +400,80 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
             kprintf(LOGLEVEL_ERR, "Unknown fault type %u\n", seL4_MessageInfo_get_label(message));
             break;
     }
+
+    return reply;
+}
+
+std::shared_ptr<InlinePayload> Thread::getInlinePayload() {
+    if (!_inlinePayload)
+        _inlinePayload = std::make_shared<InlinePayload>();
+    return _inlinePayload;
+}
+
+Reply Thread::_getSyscallReply(long number, timer::Timestamp start, async::future<int> result) noexcept {
+    Reply reply = {.isReady = true, .message = seL4_MessageInfo_new(0, 0, 0, 1)};
+    try {
+        reply.result = result.get();
+    } catch (...) {
+        reply.result = -syscall::exceptionToErrno(std::current_exception());
+        stats::recordSyscall(number, timer::getTimestamp() - start, true);
+        return reply;
+    }
+    stats::recordSyscall(number, timer::getTimestamp() - start, false);
+
+    if (_inlinePayload && _inlinePayload->length > 0) {
+        reply.message = seL4_MessageInfo_new(0, 0, 0, 1 + SOS_INLINE_WORDS(_inlinePayload->length));
+        reply.payload = _inlinePayload;
+    }
+    return reply;
+}
+
+void setReplyMRs(const Reply& reply) noexcept {
+    if (seL4_MessageInfo_get_length(reply.message) > 0)
+        seL4_SetMR(0, reply.result);
+    if (reply.payload)
+        std::copy(
+            reply.payload->data, reply.payload->data + reply.payload->length,
+            reinterpret_cast<uint8_t*>(&seL4_GetIPCBuffer()->msg[1])
+        );
+}
+
+namespace {
+    // Replies to saved reply caps, sent together just before the main loop
+    // next waits
+    struct DeferredReply {
+        std::weak_ptr<Thread> thread;
+        seL4_CPtr replyCap;
+        Reply reply;
+    };
+    std::vector<DeferredReply> _deferredReplies;
+
+    void _send(seL4_CPtr replyCap, const Reply& reply) noexcept {
+        setReplyMRs(reply);
+        seL4_Send(replyCap, reply.message);
+    }
+}
+
+void Thread::_sendLater(seL4_CPtr replyCap, const Reply& reply) noexcept {
+    try {
+        _deferredReplies.push_back(DeferredReply{shared_from_this(), replyCap, reply});
+    } catch (const std::bad_alloc&) {
+        _send(replyCap, reply);
+        assert(cspace_free_reply_cap(cur_cspace, replyCap) == CSPACE_NOERROR);
+    }
+}
+
+void sendDeferredReplies() noexcept {
+    for (const auto& deferred : _deferredReplies) {
+        // The thread might have been killed since the reply was queued, in
+        // which case its reply cap is gone too
+        std::shared_ptr<Thread> thread = deferred.thread.lock();
+        if (thread && thread->_status != Thread::Status::ZOMBIE)
+            _send(deferred.replyCap, deferred.reply);
+
+        assert(cspace_free_reply_cap(cur_cspace, deferred.replyCap) == CSPACE_NOERROR);
+    }
+    _deferredReplies.clear();
 }
 
 /////////////
@@ -314,16 +482,11 @@ void Thread::handleFault(const seL4_MessageInfo_t& message) noexcept {
 
 Process::Process(std::shared_ptr<Process> parent):
     isSosProcess(false),
-    _parent(parent),
-
-    // Create a simple 1 level CSpace
-    _cspace(cspace_create(1), [](cspace_t* cspace) {assert(cspace_destroy(cspace) == CSPACE_NOERROR);})
+    _nice(parent->_nice),
+    _parent(parent)
 {
     assert(parent);
 
-    if (!_cspace)
-        throw std::system_error(ENOMEM, std::system_category(), "Failed to create CSpace");
-
     // XXX: We shouldn't reserve pages, but currently our page table layout
     // requires this
     pageDirectory.reservePages(memory::MMAP_START, memory::MMAP_STACK_END);
@@ -333,8 +496,7 @@ Process::Process(std::shared_ptr<Process> parent):
 
 Process::Process(bool isSosProcess):
     pageDirectory(seL4_CapInitThreadPD),
-    isSosProcess(isSosProcess),
-    _cspace(cur_cspace, [](cspace_t*) {})
+    isSosProcess(isSosProcess)
 {
     assert(isSosProcess);
 
@@ -398,7 +560,7 @@ void Process::emitChildExit(std::shared_ptr<Process> process) noexcept {
     }
 }
 
-async::future<void> Process::handlePageFault(memory::vaddr_t address, memory::Attributes cause) {
+const memory::Mapping& Process::checkAccess(memory::vaddr_t address, memory::Attributes cause) const {
     address = memory::pageAlign(address);
     const memory::Mapping& map = maps.lookup(address);
 
@@ -414,7 +576,20 @@ async::future<void> Process::handlePageFault(memory::vaddr_t address, memory::At
     if (cause.write && !map.attributes.write)
         throw std::system_error(EFAULT, std::system_category(), "Attempted to write to a non-writeable region");
 
-    return pageDirectory.makeResident(address, map.attributes).then([](auto page) {
+    return map;
+}
+
+async::future<void> Process::handlePageFault(memory::vaddr_t address, memory::Attributes cause, memory::FaultType* type) {
+    address = memory::pageAlign(address);
+    const memory::Mapping& map = checkAccess(address, cause);
+
+    if (map.backing && !pageDirectory.lookup(address, true)) {
+        if (type)
+            *type = memory::FaultType::FILE_FILL;
+        return _fillPage(address, map.attributes, map.backing, type);
+    }
+
+    return pageDirectory.makeResident(address, map.attributes, type, _nice).then([](auto page) {
         (void)page.get();
     });
 }
@@ -423,17 +598,29 @@ async::future<void> Process::pageFaultMultiple(memory::vaddr_t start, size_t pag
     if (map)
         assert(map->getStart() <= start && start + pages * PAGE_SIZE <= map->getEnd());
 
-    async::promise<void> promise;
-    promise.set_value();
-    auto future = promise.get_future();
+    if (pages == 0)
+        return async::make_ready_future();
+
+    // Fault in a batch of pages at once, so their swap ins can overlap
+    size_t batchPages = std::min<size_t>(pages, CONFIG_SOS_MAX_CONCURRENT_PAGE_FAULTS);
+    std::vector<async::future<void>> faults;
+    faults.reserve(batchPages);
+    for (size_t p = 0; p < batchPages; ++p) {
+        try {
+            faults.push_back(handlePageFault(start + p * PAGE_SIZE, attributes));
+        } catch (...) {
+            faults.push_back(async::make_exceptional_future<void>(std::current_exception()));
+        }
+    }
 
-    for (size_t p = 0; p < pages; ++p) {
-        memory::vaddr_t addr = start + p * PAGE_SIZE;
-        future = future.then([this, addr, attributes, map](async::future<void> result) {
+    auto future = async::when_all(faults.begin(), faults.end()).then([=](auto results) {
+        for (auto& result : results.get())
             result.get();
-            return this->handlePageFault(addr, attributes);
-        });
-    }
+
+        if (batchPages == pages)
+            return async::make_ready_future();
+        return this->pageFaultMultiple(start + batchPages * PAGE_SIZE, pages - batchPages, attributes, map);
+    }).unwrap();
 
     if (isSosProcess && !future.is_ready()) {
         // Can't block SOS
@@ -443,24 +630,86 @@ async::future<void> Process::pageFaultMultiple(memory::vaddr_t start, size_t pag
     return future;
 }
 
-pid_t Process::getPid() const noexcept {
-    if (isSosProcess)
-        return 0;
+async::future<void> Process::_fillPage(memory::vaddr_t address, memory::Attributes attributes, std::shared_ptr<const memory::Backing> backing, memory::FaultType* type) {
+    if (backing->sharedPages) {
+        auto sharedPage = backing->sharedPages->find(address);
+        if (sharedPage != backing->sharedPages->end()) {
+            if (type)
+                *type = memory::FaultType::MINOR;
+            _mapFilledPage(sharedPage->second.copy(), address, attributes);
+            return async::make_ready_future();
+        }
+    }
+
+    std::weak_ptr<Process> process = shared_from_this();
+    return memory::FrameTable::alloc(_nice).then([process, address, attributes, backing](auto page) {
+        auto _page = page.get();
+        auto _process = process.lock();
+        if (!_process)
+            return;
+
+        // Something else might have faulted it in, or unmapped it, in the
+        // meantime
+        if (_process->pageDirectory.lookup(address, true))
+            return;
+        if (_process->maps.lookup(address).backing != backing)
+            throw std::system_error(EFAULT, std::system_category(), "Mapping changed while being faulted in");
+
+        if (!backing->sharedPages) {
+            backing->fill(_page.getWindowAddress(), address);
+            _process->_mapFilledPage(std::move(_page), address, attributes);
+            return;
+        }
+
+        // Another process might have filled in the shared page first, in
+        // which case the new one is just dropped
+        auto sharedPage = backing->sharedPages->find(address);
+        if (sharedPage == backing->sharedPages->end()) {
+            backing->fill(_page.getWindowAddress(), address);
+            sharedPage = backing->sharedPages->emplace(address, std::move(_page)).first;
+        }
+        _process->_mapFilledPage(sharedPage->second.copy(), address, attributes);
+    });
+}
+
+void Process::_mapFilledPage(memory::Page page, memory::vaddr_t address, memory::Attributes attributes) {
+    const auto& mappedPage = pageDirectory.map(std::move(page), address, attributes);
 
-    // TODO: Supports only single-threaded processes
-    assert(_threads.size() > 0);
-    auto thread = _threads.begin()->lock();
+    if (attributes.execute) {
+        // Unify the data and instruction cache's view of the page
+        assert(seL4_ARM_Page_Unify_Instruction(mappedPage.getPage().getCap(), 0, PAGE_SIZE) == seL4_NoError);
+    }
+}
 
-    assert(thread);
-    return thread->getTid();
+void Process::kill() noexcept {
+    // Killing a thread can change _threads
+    auto threads = _threads;
+    for (const auto& thread : threads) {
+        if (auto _thread = thread.lock())
+            _thread->kill();
+    }
+}
+
+void Process::setNice(int nice) noexcept {
+    _nice = std::max(MIN_NICE, std::min(nice, MAX_NICE));
+    for (const auto& thread : _threads) {
+        if (auto _thread = thread.lock())
+            _thread->updatePriority();
+    }
+}
+
+async::Executor& Process::getReplyExecutor() const noexcept {
+    if (_nice < 0)
+        return async::urgentReplyExecutor;
+    else if (_nice > 0)
+        return async::niceReplyExecutor;
+    else
+        return async::replyExecutor;
 }
 
 void Process::_shrinkZombie() noexcept {
     assert(_isZombie);
-
-    fdTable.clear();
-    maps.clear();
-    pageDirectory.clear();
+    Reaper::get().add(shared_from_this());
 }
 
 std::shared_ptr<Process> getSosProcess() noexcept {
@@ -0,0 +1,154 @@
+#include <limits>
+#include <stdexcept>
+
+extern "C" {
+    #include "internal/sys/debug.h"
+    #include "internal/sys/panic.h"
+}
+
+#include "internal/Future.h"
+#include "internal/async.h"
+#include "internal/selftest.h"
+
+namespace selftest {
+
+namespace {
+    template <typename F>
+    bool _throws(F&& f) {
+        try {
+            f();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    void _futureThen() {
+        auto ready = async::makeReadyFuture(1).then([](async::Future<int> value) {
+            return value.get() + 1;
+        });
+        conditional_panic(!ready.is_ready(), "then() on a ready future isn't ready");
+        conditional_panic(ready.get() != 2, "then() on a ready future has the wrong value");
+
+        async::Promise<int> promise;
+        auto pending = promise.get_future().then([](async::Future<int> value) {
+            return value.get() + 1;
+        }).then([](async::Future<int> value) {
+            return value.get() * 2;
+        });
+        conditional_panic(pending.is_ready(), "then() on a pending future is ready");
+        promise.set_value(1);
+        conditional_panic(!pending.is_ready(), "then() chain isn't ready after set_value()");
+        conditional_panic(pending.get() != 4, "then() chain has the wrong value");
+
+        async::Promise<void> voidPromise;
+        bool ran = false;
+        auto voidResult = voidPromise.get_future().then([&ran](async::Future<void> value) {
+            value.get();
+            ran = true;
+        });
+        voidPromise.set_value();
+        conditional_panic(!ran || !voidResult.has_value(), "then() on a void future didn't run");
+    }
+
+    void _futureExceptions() {
+        // Exceptions from the promise pass through continuations that get()
+        async::Promise<int> promise;
+        bool ran = false;
+        auto fromPromise = promise.get_future().then([](async::Future<int> value) {
+            return value.get() + 1;
+        }).then([&ran](async::Future<int> value) {
+            ran = true;
+            return value.get();
+        });
+        promise.set_exception(std::runtime_error("promise"));
+        conditional_panic(!ran, "continuation didn't run after set_exception()");
+        conditional_panic(!fromPromise.has_exception(), "set_exception() didn't propagate");
+        conditional_panic(!_throws([&] {fromPromise.get();}), "get() didn't rethrow");
+
+        // ... as do exceptions thrown by the continuations themselves
+        auto fromThen = async::makeReadyFuture(1).then([](async::Future<int>) -> int {
+            throw std::runtime_error("then");
+        });
+        conditional_panic(!fromThen.has_exception(), "exception in then() didn't propagate");
+        conditional_panic(!_throws([&] {fromThen.get();}), "get() didn't rethrow");
+
+        // Abandoned promises break their futures
+        async::Future<int> broken;
+        {
+            async::Promise<int> abandoned;
+            broken = abandoned.get_future();
+        }
+        conditional_panic(!broken.has_exception(), "abandoned promise didn't break its future");
+        bool isBroken = false;
+        try {
+            broken.get();
+        } catch (const boost::broken_promise&) {
+            isBroken = true;
+        }
+        conditional_panic(!isBroken, "abandoned promise threw the wrong exception");
+    }
+
+    void _futureUnwrap() {
+        auto ready = async::makeReadyFuture(1).then([](async::Future<int> value) {
+            return async::makeReadyFuture(value.get() + 1);
+        }).unwrap();
+        conditional_panic(!ready.is_ready() || ready.get() != 2, "unwrap() of ready futures failed");
+
+        async::Promise<int> outer;
+        async::Promise<int> inner;
+        auto pending = outer.get_future().then([&inner](async::Future<int> value) {
+            value.get();
+            return inner.get_future();
+        }).unwrap();
+        outer.set_value(1);
+        conditional_panic(pending.is_ready(), "unwrap() is ready before the inner future");
+        inner.set_value(2);
+        conditional_panic(!pending.is_ready() || pending.get() != 2, "unwrap() of pending futures failed");
+
+        async::Promise<int> outerFailing;
+        auto outerException = outerFailing.get_future().then([](async::Future<int> value) {
+            return async::makeReadyFuture(value.get());
+        }).unwrap();
+        outerFailing.set_exception(std::runtime_error("outer"));
+        conditional_panic(!_throws([&] {outerException.get();}), "unwrap() lost the outer exception");
+
+        async::Promise<int> innerFailing;
+        auto innerException = async::makeReadyFuture(1).then([&innerFailing](async::Future<int>) {
+            return innerFailing.get_future();
+        }).unwrap();
+        innerFailing.set_exception(std::runtime_error("inner"));
+        conditional_panic(!_throws([&] {innerException.get();}), "unwrap() lost the inner exception");
+    }
+
+    void _futureDeferral() {
+        async::Promise<int> promise;
+        auto pending = promise.get_future().then([](async::Future<int> value) {
+            return value.get() + 1;
+        });
+        async::Future<int> ready;
+        {
+            async::RunQueue::Deferral deferral;
+            promise.set_value(1);
+            ready = async::makeReadyFuture(1).then([](async::Future<int> value) {
+                return value.get() + 1;
+            });
+        }
+        conditional_panic(pending.is_ready(), "continuation ran inline while deferring");
+        conditional_panic(ready.is_ready(), "continuation of a ready future ran inline while deferring");
+
+        async::RunQueue::get().run(std::numeric_limits<size_t>::max());
+        conditional_panic(!pending.is_ready() || pending.get() != 2, "deferred continuation didn't run");
+        conditional_panic(!ready.is_ready() || ready.get() != 2, "deferred continuation of a ready future didn't run");
+    }
+}
+
+void run() noexcept {
+    kprintf(LOGLEVEL_NOTICE, "Running self tests...\n");
+    _futureThen();
+    _futureExceptions();
+    _futureUnwrap();
+    _futureDeferral();
+}
+
+}
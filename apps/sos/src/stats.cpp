@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <string>
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "internal/memory/PageDirectory.h"
+#include "internal/stats.h"
+
+namespace stats {
+
+namespace {
+    // Linux' syscall numbers are small, and ours start from 0x10000, so two
+    // flat tables cover everything without any lookups
+    constexpr const long LINUX_SYSCALLS = 512;
+    constexpr const long SOS_SYSCALLS_START = 0x10000;
+    constexpr const long SOS_SYSCALLS = 16;
+
+    std::array<Counter, LINUX_SYSCALLS> _linuxSyscalls;
+    std::array<Counter, SOS_SYSCALLS> _sosSyscalls;
+    Counter _unknownSyscalls;
+
+    constexpr const size_t FAULT_TYPES = 4;
+    constexpr const char* FAULT_NAMES[FAULT_TYPES] = {"minor", "zero-fill", "swap-in", "file-fill"};
+    std::array<Counter, FAULT_TYPES> _faults;
+
+    void _format(std::string& out, const char* name, const Counter& counter) {
+        if (counter.count == 0)
+            return;
+
+        char buffer[128];
+        snprintf(
+            buffer, sizeof(buffer), "%s count %llu errors %llu latency",
+            name,
+            static_cast<unsigned long long>(counter.count),
+            static_cast<unsigned long long>(counter.errors)
+        );
+        out += buffer;
+
+        for (size_t b = 0; b < LATENCY_BUCKETS; ++b) {
+            if (counter.histogram[b] == 0)
+                continue;
+
+            snprintf(buffer, sizeof(buffer), " %zu:%u", b, counter.histogram[b]);
+            out += buffer;
+        }
+        out += '\n';
+    }
+}
+
+void Counter::record(timer::Duration latency, bool isError) noexcept {
+    ++count;
+    if (isError)
+        ++errors;
+
+    uint64_t microseconds = latency.count();
+    size_t bucket = microseconds == 0 ? 0 : 64 - __builtin_clzll(microseconds);
+    ++histogram[std::min(bucket, LATENCY_BUCKETS - 1)];
+}
+
+void recordSyscall(long number, timer::Duration latency, bool isError) noexcept {
+    if (0 <= number && number < LINUX_SYSCALLS)
+        _linuxSyscalls[number].record(latency, isError);
+    else if (SOS_SYSCALLS_START <= number && number < SOS_SYSCALLS_START + SOS_SYSCALLS)
+        _sosSyscalls[number - SOS_SYSCALLS_START].record(latency, isError);
+    else
+        _unknownSyscalls.record(latency, isError);
+}
+
+void recordFault(memory::FaultType type, timer::Duration latency, bool isError) noexcept {
+    size_t index = static_cast<size_t>(type);
+    assert(index < FAULT_TYPES);
+    _faults[index].record(latency, isError);
+}
+
+std::string format() {
+    std::string result;
+    char name[32];
+
+    for (long n = 0; n < LINUX_SYSCALLS; ++n) {
+        snprintf(name, sizeof(name), "syscall %ld", n);
+        _format(result, name, _linuxSyscalls[n]);
+    }
+    for (long n = 0; n < SOS_SYSCALLS; ++n) {
+        snprintf(name, sizeof(name), "syscall %#lx", SOS_SYSCALLS_START + n);
+        _format(result, name, _sosSyscalls[n]);
+    }
+    _format(result, "syscall unknown", _unknownSyscalls);
+
+    for (size_t t = 0; t < FAULT_TYPES; ++t) {
+        snprintf(name, sizeof(name), "fault %s", FAULT_NAMES[t]);
+        _format(result, name, _faults[t]);
+    }
+
+    return result;
+}
+
+}
@@ -1,11 +1,15 @@
+#include <algorithm>
+#include <array>
 #include <stdexcept>
 #include <system_error>
 
 #include <sys/uio.h>
 #include <dirent.h>
+#include <poll.h>
 
 #include "internal/fs/File.h"
 #include "internal/fs/FileDescriptor.h"
+#include "internal/fs/Pipe.h"
 #include "internal/memory/UserMemory.h"
 #include "internal/syscall/fs.h"
 
@@ -15,18 +19,29 @@
 namespace syscall {
 
 namespace {
-    async::future<ssize_t> _preadwritev2(bool isWrite, std::weak_ptr<process::Process> process, int fd, const std::vector<fs::IoVector>& iov, off64_t offset) {
-        if (iov.size() == 0)
-            return async::make_ready_future(0);
-
+    // Fails with EAGAIN if the file was opened non-blocking and isn't ready
+    // to be read from or written to yet
+    std::shared_ptr<fs::File> _getReadyFile(const fs::OpenFile& openFile, bool isWrite) {
         fs::OpenFile::Flags flags = {
             .read = !isWrite,
             .write = isWrite
         };
 
-        auto file = std::shared_ptr<process::Process>(process)->fdTable.get(fd, flags);
+        auto file = openFile.get(flags);
+        if (openFile.isNonBlocking() && !(file->getReadiness() & (isWrite ? POLLOUT : POLLIN)))
+            throw std::system_error(EAGAIN, std::system_category());
+
+        return file;
+    }
+
+    async::future<ssize_t> _preadwritev2(bool isWrite, std::weak_ptr<process::Process> process, int fd, const std::vector<fs::IoVector>& iov, off64_t offset) {
+        if (iov.size() == 0)
+            return async::make_ready_future(0);
+
+        auto openFile = std::shared_ptr<process::Process>(process)->fdTable.get(fd);
+        auto file = _getReadyFile(*openFile, isWrite);
         if (isWrite)
-            return file->write(iov, offset);
+            return file->write(iov, offset, openFile->isNonBlocking());
         else
             return file->read(iov, offset);
     }
@@ -76,6 +91,120 @@ namespace {
             offset
         );
     }
+
+    fs::FileSystem::OpenFlags _getOpenFlags(int flags, mode_t mode) {
+        fs::FileSystem::OpenFlags openFlags = {0};
+        int access = flags & O_ACCMODE;
+        if (access == O_RDONLY) {
+            openFlags.read = true;
+        } else if (access == O_WRONLY) {
+            openFlags.write = true;
+        } else if (access == O_RDWR) {
+            openFlags.read = true;
+            openFlags.write = true;
+        } else {
+            throw std::invalid_argument("File must be opened with some permissions");
+        }
+
+        // XXX: Ignore these flags for now
+        flags &= ~(O_TRUNC | O_LARGEFILE);
+
+        // Kept on the fs::OpenFile or fs::FDTable rather than passed to the
+        // file system
+        flags &= ~(O_NONBLOCK | O_CLOEXEC);
+
+        if (flags & O_CREAT) {
+            if (mode & ~07777)
+                throw std::invalid_argument("Invalid mode");
+
+            openFlags.createOnMissing = true;
+            openFlags.mode = mode;
+        }
+
+        if (flags & ~(O_ACCMODE | O_CREAT | O_DIRECTORY))
+            throw std::invalid_argument("Invalid flags");
+
+        return openFlags;
+    }
+
+    async::future<int> _open(std::weak_ptr<process::Process> process, const std::string& pathname, int flags, fs::FileSystem::OpenFlags openFlags) {
+        return fs::rootFileSystem->open(pathname, openFlags).then([flags, openFlags, process](auto file) {
+            auto _file = file.get();
+
+            if (std::dynamic_pointer_cast<fs::Directory>(_file)) {
+                if (openFlags.write)
+                    throw std::system_error(EISDIR, std::system_category(), "Cannot open a directory for writing");
+            } else {
+                if (flags & O_DIRECTORY)
+                    throw std::system_error(ENOTDIR, std::system_category(), "O_DIRECTORY set but file isn't a directory");
+            }
+
+            return std::shared_ptr<process::Process>(process)->fdTable.insert(std::make_shared<fs::OpenFile>(
+                _file,
+                fs::OpenFile::Flags{.read = openFlags.read, .write = openFlags.write},
+                flags & O_NONBLOCK
+            ), flags & O_CLOEXEC);
+        });
+    }
+
+    // Offsets for sendfile() and copy_file_range() are optional pointers to
+    // where to start from, which are updated afterwards instead of the file's
+    // own offset
+    async::future<off64_t> _getOffset(std::weak_ptr<process::Process> process, memory::vaddr_t offset) {
+        if (!offset)
+            return async::make_ready_future(fs::CURRENT_OFFSET);
+
+        return memory::UserMemory(process, offset).get<off64_t>().then([](auto offset) {
+            off64_t _offset = offset.get();
+            if (_offset < 0)
+                throw std::invalid_argument("Invalid offset");
+            return _offset;
+        });
+    }
+
+    async::future<void> _setOffset(std::weak_ptr<process::Process> process, memory::vaddr_t offset, off64_t value) {
+        if (!offset)
+            return async::make_ready_future();
+
+        return memory::UserMemory(process, offset).set(value);
+    }
+
+    async::future<ssize_t> _copy(std::weak_ptr<process::Process> process, int inFd, memory::vaddr_t inOffset, int outFd, memory::vaddr_t outOffset, size_t count) {
+        auto _process = std::shared_ptr<process::Process>(process);
+        auto in = _getReadyFile(*_process->fdTable.get(inFd), false);
+        auto out = _getReadyFile(*_process->fdTable.get(outFd), true);
+
+        return async::when_all(
+            _getOffset(process, inOffset),
+            _getOffset(process, outOffset)
+        ).then([=](auto results) {
+            auto _results = results.get();
+            off64_t _inOffset = std::get<0>(_results).get();
+            off64_t _outOffset = std::get<1>(_results).get();
+
+            return fs::copy(in, _inOffset, out, _outOffset, count).then([=](auto copied) {
+                ssize_t _copied = copied.get();
+                return _setOffset(process, inOffset, _inOffset + _copied).then([=](auto result) {
+                    result.get();
+                    return _setOffset(process, outOffset, _outOffset + _copied);
+                }).unwrap().then([_copied](auto result) {
+                    result.get();
+                    return _copied;
+                });
+            }).unwrap();
+        }).unwrap();
+    }
+
+    // Copies out a NUL terminated string from an inline payload
+    std::string _getInlineString(size_t argc, const seL4_Word* argv) {
+        const char* begin = reinterpret_cast<const char*>(argv);
+        const char* end = begin + argc * sizeof(seL4_Word);
+        const char* nul = std::find(begin, end, '\0');
+        if (nul == end)
+            throw std::invalid_argument("Inline string isn't NUL terminated");
+
+        return std::string(begin, nul);
+    }
 }
 
 async::future<int> stat64(std::weak_ptr<process::Process> process, memory::vaddr_t pathname, memory::vaddr_t buf) {
@@ -90,58 +219,83 @@ async::future<int> stat64(std::weak_ptr<process::Process> process, memory::vaddr
 }
 
 async::future<int> open(std::weak_ptr<process::Process> process, memory::vaddr_t pathname, int flags, mode_t mode) {
-    fs::FileSystem::OpenFlags openFlags = {0};
-    int access = flags & O_ACCMODE;
-    if (access == O_RDONLY) {
-        openFlags.read = true;
-    } else if (access == O_WRONLY) {
-        openFlags.write = true;
-    } else if (access == O_RDWR) {
-        openFlags.read = true;
-        openFlags.write = true;
-    } else {
-        throw std::invalid_argument("File must be opened with some permissions");
-    }
+    fs::FileSystem::OpenFlags openFlags = _getOpenFlags(flags, mode);
+    return memory::UserMemory(process, pathname).readString().then([process, flags, openFlags](auto pathname) {
+        return _open(process, pathname.get(), flags, openFlags);
+    }).unwrap();
+}
 
-    // XXX: Ignore these flags for now
-    flags &= ~(O_TRUNC | O_LARGEFILE | O_CLOEXEC);
+async::future<int> close(std::weak_ptr<process::Process> process, int fd) {
+    if (std::shared_ptr<process::Process>(process)->fdTable.erase(fd))
+        return async::make_ready_future(0);
 
-    if (flags & O_CREAT) {
-        if (mode & ~07777)
-            throw std::invalid_argument("Invalid mode");
+    throw std::system_error(EBADF, std::system_category());
+}
 
-        openFlags.createOnMissing = true;
-        openFlags.mode = mode;
-    }
+async::future<int> pipe(std::weak_ptr<process::Process> process, memory::vaddr_t pipefd) {
+    return pipe2(process, pipefd, 0);
+}
 
-    if (flags & ~(O_ACCMODE | O_CREAT | O_DIRECTORY))
+async::future<int> pipe2(std::weak_ptr<process::Process> process, memory::vaddr_t pipefd, int flags) {
+    if (flags & ~(O_NONBLOCK | O_CLOEXEC))
         throw std::invalid_argument("Invalid flags");
 
-    return memory::UserMemory(process, pathname).readString().then([openFlags](auto pathname) {
-        return fs::rootFileSystem->open(pathname.get(), openFlags);
-    }).unwrap().then([flags, openFlags, process](auto file) {
-        auto _file = file.get();
+    auto ends = fs::Pipe::create();
+    auto& fdTable = std::shared_ptr<process::Process>(process)->fdTable;
+
+    std::array<int, 2> fds;
+    fds[0] = fdTable.insert(
+        std::make_shared<fs::OpenFile>(ends.first, fs::OpenFile::Flags{.read = true, .write = false}, flags & O_NONBLOCK),
+        flags & O_CLOEXEC
+    );
+    try {
+        fds[1] = fdTable.insert(
+            std::make_shared<fs::OpenFile>(ends.second, fs::OpenFile::Flags{.read = false, .write = true}, flags & O_NONBLOCK),
+            flags & O_CLOEXEC
+        );
+    } catch (...) {
+        fdTable.erase(fds[0]);
+        throw;
+    }
 
-        if (std::dynamic_pointer_cast<fs::Directory>(_file)) {
-            if (openFlags.write)
-                throw std::system_error(EISDIR, std::system_category(), "Cannot open a directory for writing");
-        } else {
-            if (flags & O_DIRECTORY)
-                throw std::system_error(ENOTDIR, std::system_category(), "O_DIRECTORY set but file isn't a directory");
+    return memory::UserMemory(process, pipefd).set(fds).then([process, fds](async::future<void> result) {
+        try {
+            result.get();
+            return 0;
+        } catch (...) {
+            if (auto _process = process.lock()) {
+                _process->fdTable.erase(fds[0]);
+                _process->fdTable.erase(fds[1]);
+            }
+            throw;
         }
-
-        return std::shared_ptr<process::Process>(process)->fdTable.insert(std::make_shared<fs::OpenFile>(
-            _file,
-            fs::OpenFile::Flags{.read = openFlags.read, .write = openFlags.write}
-        ));
     });
 }
 
-async::future<int> close(std::weak_ptr<process::Process> process, int fd) {
-    if (std::shared_ptr<process::Process>(process)->fdTable.erase(fd))
-        return async::make_ready_future(0);
+async::future<int> dup(std::weak_ptr<process::Process> process, int oldFd) {
+    auto& fdTable = std::shared_ptr<process::Process>(process)->fdTable;
+    return async::make_ready_future(fdTable.insert(fdTable.get(oldFd)));
+}
 
-    throw std::system_error(EBADF, std::system_category());
+async::future<int> dup2(std::weak_ptr<process::Process> process, int oldFd, int newFd) {
+    if (oldFd == newFd) {
+        // Still has to check it's valid
+        std::shared_ptr<process::Process>(process)->fdTable.get(oldFd);
+        return async::make_ready_future(newFd);
+    }
+
+    return dup3(process, oldFd, newFd, 0);
+}
+
+async::future<int> dup3(std::weak_ptr<process::Process> process, int oldFd, int newFd, int flags) {
+    if (flags & ~O_CLOEXEC)
+        throw std::invalid_argument("Invalid flags");
+    if (oldFd == newFd)
+        throw std::invalid_argument("Cannot duplicate a file descriptor onto itself");
+
+    auto& fdTable = std::shared_ptr<process::Process>(process)->fdTable;
+    fdTable.insertAt(newFd, fdTable.get(oldFd), flags & O_CLOEXEC);
+    return async::make_ready_future(newFd);
 }
 
 async::future<int> read(std::weak_ptr<process::Process> process, int fd, memory::vaddr_t buf, size_t count) {
@@ -190,11 +344,130 @@ async::future<int> getdents64(std::weak_ptr<process::Process> process, int fd, m
     return directory->getdents(memory::UserMemory(process, dirp), count);
 }
 
+async::future<int> sendfile64(std::weak_ptr<process::Process> process, int outFd, int inFd, memory::vaddr_t offset, size_t count) {
+    return _copy(process, inFd, offset, outFd, 0, count);
+}
+
+async::future<int> copy_file_range(std::weak_ptr<process::Process> process, int inFd, memory::vaddr_t inOffset, int outFd, memory::vaddr_t outOffset, size_t count, unsigned int flags) {
+    if (flags != 0)
+        throw std::invalid_argument("Invalid flags");
+    return _copy(process, inFd, inOffset, outFd, outOffset, count);
+}
+
+async::future<int> sos_inline_stat64(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv) {
+    static_assert(sizeof(struct stat) <= SOS_INLINE_MAX, "struct stat doesn't fit in an inline reply");
+
+    auto payload = std::shared_ptr<process::Thread>(thread)->getInlinePayload();
+    return fs::rootFileSystem->stat(_getInlineString(argc, argv)).then([payload](auto stat) {
+        struct stat _stat = stat.get();
+        std::copy(
+            reinterpret_cast<const uint8_t*>(&_stat), reinterpret_cast<const uint8_t*>(&_stat + 1),
+            payload->data
+        );
+        payload->length = sizeof(_stat);
+        return 0;
+    });
+}
+
+async::future<int> sos_inline_open(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv) {
+    if (argc < 2)
+        throw std::invalid_argument("Missing arguments");
+
+    int flags = argv[0];
+    fs::FileSystem::OpenFlags openFlags = _getOpenFlags(flags, argv[1]);
+    return _open(
+        std::shared_ptr<process::Thread>(thread)->getProcess(),
+        _getInlineString(argc - 2, argv + 2),
+        flags, openFlags
+    );
+}
+
+async::future<int> sos_inline_read(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv) {
+    if (argc < 2)
+        throw std::invalid_argument("Missing arguments");
+
+    int fd = argv[0];
+    size_t count = argv[1];
+    if (count > SOS_INLINE_MAX)
+        throw std::invalid_argument("Too much to read inline");
+
+    std::shared_ptr<process::Thread> _thread(thread);
+    auto payload = _thread->getInlinePayload();
+
+    // The payload is kept alive until the read finishes, even if the thread
+    // isn't
+    return _preadwritev2(
+        false, _thread->getProcess(), fd,
+        std::vector<fs::IoVector>{fs::IoVector{
+            .buffer = memory::UserMemory(process::getSosProcess(), reinterpret_cast<memory::vaddr_t>(payload->data)),
+            .length = count
+        }},
+        fs::CURRENT_OFFSET
+    ).then([payload](auto read) {
+        ssize_t _read = read.get();
+        payload->length = _read;
+        return _read;
+    });
+}
+
+async::future<int> sos_inline_write(std::weak_ptr<process::Thread> thread, size_t argc, const seL4_Word* argv) {
+    if (argc < 2)
+        throw std::invalid_argument("Missing arguments");
+
+    int fd = argv[0];
+    size_t count = argv[1];
+    if (count > SOS_INLINE_MAX || argc - 2 < SOS_INLINE_WORDS(count))
+        throw std::invalid_argument("Inline payload is truncated");
+
+    std::shared_ptr<process::Thread> _thread(thread);
+    auto payload = _thread->getInlinePayload();
+
+    // Copy it out now, since the IPC buffer is reused for the next message
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(argv + 2);
+    std::copy(data, data + count, payload->data);
+
+    return _preadwritev2(
+        true, _thread->getProcess(), fd,
+        std::vector<fs::IoVector>{fs::IoVector{
+            .buffer = memory::UserMemory(process::getSosProcess(), reinterpret_cast<memory::vaddr_t>(payload->data)),
+            .length = count
+        }},
+        fs::CURRENT_OFFSET
+    ).then([payload](auto written) {
+        return written.get();
+    });
+}
+
 async::future<int> fcntl64(std::weak_ptr<process::Process> process, int fd, int cmd, int arg) {
-    std::shared_ptr<process::Process>(process)->fdTable.get(fd, fs::OpenFile::Flags{});
+    auto& fdTable = std::shared_ptr<process::Process>(process)->fdTable;
+    auto openFile = fdTable.get(fd);
 
-    if (cmd == F_SETFD && arg == FD_CLOEXEC)
-        return async::make_ready_future(0); // XXX: Ignore for now
+    if (cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC) {
+        return async::make_ready_future(fdTable.insert(openFile, cmd == F_DUPFD_CLOEXEC, arg));
+    }
+
+    if (cmd == F_GETFD)
+        return async::make_ready_future(fdTable.isCloseOnExec(fd) ? FD_CLOEXEC : 0);
+
+    if (cmd == F_SETFD) {
+        fdTable.setCloseOnExec(fd, arg & FD_CLOEXEC);
+        return async::make_ready_future(0);
+    }
+
+    if (cmd == F_GETFL) {
+        auto flags = openFile->getFlags();
+        int result = flags.read && flags.write ? O_RDWR : flags.write ? O_WRONLY : O_RDONLY;
+        if (openFile->isNonBlocking())
+            result |= O_NONBLOCK;
+        return async::make_ready_future(result);
+    }
+
+    if (cmd == F_SETFL) {
+        // The access mode can't be changed, and like Linux, other flags that
+        // can't be changed are ignored
+        openFile->setNonBlocking(arg & O_NONBLOCK);
+        return async::make_ready_future(0);
+    }
 
     throw std::system_error(ENOSYS, std::system_category());
 }
@@ -211,6 +484,12 @@ FORWARD_SYSCALL(stat64, 2);
 FORWARD_SYSCALL(open, 3);
 FORWARD_SYSCALL(close, 1);
 
+FORWARD_SYSCALL(pipe, 1);
+FORWARD_SYSCALL(pipe2, 2);
+FORWARD_SYSCALL(dup, 1);
+FORWARD_SYSCALL(dup2, 2);
+FORWARD_SYSCALL(dup3, 3);
+
 FORWARD_SYSCALL(read, 3);
 FORWARD_SYSCALL(readv, 3);
 FORWARD_SYSCALL(pread64, 6);
@@ -0,0 +1,175 @@
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <time.h>
+
+extern "C" {
+    #include <sos.h>
+}
+
+#include "internal/memory/UserMemory.h"
+#include "internal/syscall/futex.h"
+#include "internal/timer/timer.h"
+
+namespace syscall {
+
+namespace {
+    // Where the futex is in physical memory, so it's the same for every
+    // mapping of it, in any process
+    using FutexKey = std::pair<const memory::FrameTable::Frame*, size_t>;
+
+    struct Waiter {
+        std::weak_ptr<process::Thread> thread;
+        async::promise<int> promise;
+
+        // Keeps the page locked in memory, and hence the key valid, until
+        // the waiter is woken up
+        memory::ScopedMapping map;
+        timer::TimerId timer;
+    };
+
+    std::map<FutexKey, std::list<std::shared_ptr<Waiter>>> _waiters;
+
+    FutexKey _getKey(const memory::MappedPage& page, memory::vaddr_t address) {
+        const memory::FrameTable::Frame* frame = page.getPage().getFrame();
+        if (!frame)
+            throw std::invalid_argument("Futexes must be in normal memory");
+
+        return FutexKey(frame, memory::pageOffset(address));
+    }
+
+    void _removeWaiter(const FutexKey& key, const std::shared_ptr<Waiter>& waiter) noexcept {
+        auto waiters = _waiters.find(key);
+        if (waiters == _waiters.end())
+            return;
+
+        waiters->second.remove(waiter);
+        if (waiters->second.empty())
+            _waiters.erase(waiters);
+    }
+
+    async::future<int> _wait(std::weak_ptr<process::Thread> thread, memory::vaddr_t address, int value, memory::vaddr_t timeout) {
+        std::weak_ptr<process::Process> process = std::shared_ptr<process::Thread>(thread)->getProcess();
+
+        auto getTimeout = async::make_ready_future(timespec{});
+        if (timeout)
+            getTimeout = memory::UserMemory(process, timeout).get<timespec>();
+
+        return getTimeout.then([=](auto timeoutSpec) {
+            auto _timeoutSpec = timeoutSpec.get();
+            if (_timeoutSpec.tv_sec < 0 || !(0 <= _timeoutSpec.tv_nsec && _timeoutSpec.tv_nsec <= 999999999))
+                throw std::invalid_argument("Invalid timeout");
+
+            using namespace std::chrono;
+            auto delay = duration_cast<timer::Duration>(seconds(_timeoutSpec.tv_sec) + nanoseconds(_timeoutSpec.tv_nsec));
+
+            return memory::UserMemory(process, address).mapIn<int>(1, memory::Attributes{.read = true}).then([=](auto map) {
+                auto _map = std::move(map.get());
+
+                // Nothing else runs in between checking the value and
+                // queueing up, so a wake after the value is changed can't be
+                // missed
+                if (__atomic_load_n(_map.first, __ATOMIC_SEQ_CST) != value)
+                    throw std::system_error(EAGAIN, std::system_category(), "Futex value changed");
+
+                auto key = _getKey(*std::shared_ptr<process::Process>(process)->pageDirectory.lookup(memory::pageAlign(address)), address);
+                auto waiter = std::make_shared<Waiter>(Waiter{thread, async::promise<int>(), std::move(_map.second), 0});
+                _waiters[key].push_back(waiter);
+
+                if (timeout) {
+                    std::weak_ptr<Waiter> weakWaiter = waiter;
+                    waiter->timer = timer::setTimer(delay, [key, weakWaiter] {
+                        auto _waiter = weakWaiter.lock();
+                        if (!_waiter)
+                            return;
+
+                        _removeWaiter(key, _waiter);
+                        _waiter->promise.set_exception(std::system_error(ETIMEDOUT, std::system_category(), "Futex wait timed out"));
+                    });
+                }
+
+                return waiter->promise.get_future();
+            }).unwrap();
+        }).unwrap();
+    }
+}
+
+async::future<int> futex(std::weak_ptr<process::Thread> thread, memory::vaddr_t address, int op, int value, memory::vaddr_t timeout) {
+    if (address % sizeof(int) != 0)
+        throw std::invalid_argument("Futex is not aligned");
+
+    // Futexes are keyed by physical address anyway, so private ones are no
+    // different
+    switch (op & ~FUTEX_PRIVATE_FLAG) {
+        case FUTEX_WAIT:
+            return _wait(thread, address, value, timeout);
+
+        case FUTEX_WAKE:
+            return async::make_ready_future(wakeFutex(*std::shared_ptr<process::Thread>(thread)->getProcess(), address, value));
+
+        default:
+            throw std::system_error(ENOSYS, std::system_category(), "Unsupported futex operation");
+    }
+}
+
+int wakeFutex(const process::Process& process, memory::vaddr_t address, int count) {
+    // Anyone waiting would be keeping the page in memory
+    const memory::MappedPage* page = process.pageDirectory.lookup(memory::pageAlign(address), true);
+    if (!page || page->getPage().getStatus() == memory::Page::Status::SWAPPED)
+        return 0;
+
+    auto waiters = _waiters.find(_getKey(*page, address));
+    if (waiters == _waiters.end())
+        return 0;
+
+    int woken = 0;
+    while (woken < count && !waiters->second.empty()) {
+        auto waiter = std::move(waiters->second.front());
+        waiters->second.pop_front();
+
+        if (waiter->timer)
+            timer::clearTimer(waiter->timer);
+        waiter->promise.set_value(0);
+
+        // Threads that were killed while waiting don't count
+        if (!waiter->thread.expired())
+            ++woken;
+    }
+
+    if (waiters->second.empty())
+        _waiters.erase(waiters);
+
+    return woken;
+}
+
+void cancelFutexWaits(const process::Thread& thread) noexcept {
+    // Dropping a waiter breaks its promise, which frees the saved reply cap.
+    // Keep them until the end so that doesn't run in the middle of this
+    std::vector<std::shared_ptr<Waiter>> cancelled;
+    for (auto waiters = _waiters.begin(); waiters != _waiters.end();) {
+        waiters->second.remove_if([&](const std::shared_ptr<Waiter>& waiter) {
+            auto waiterThread = waiter->thread.lock();
+            if (waiterThread && waiterThread.get() != &thread)
+                return false;
+
+            if (waiter->timer)
+                timer::clearTimer(waiter->timer);
+            cancelled.push_back(waiter);
+            return true;
+        });
+
+        if (waiters->second.empty())
+            waiters = _waiters.erase(waiters);
+        else
+            ++waiters;
+    }
+}
+
+}
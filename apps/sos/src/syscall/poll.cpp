@@ -0,0 +1,134 @@
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/epoll.h>
+
+#include "internal/fs/EventPoll.h"
+#include "internal/fs/FileDescriptor.h"
+#include "internal/memory/UserMemory.h"
+#include "internal/syscall/poll.h"
+
+namespace syscall {
+
+namespace {
+    std::shared_ptr<fs::EventPoll> _getEventPoll(std::weak_ptr<process::Process> process, int epfd) {
+        auto epoll = std::dynamic_pointer_cast<fs::EventPoll>(
+            std::shared_ptr<process::Process>(process)->fdTable.get(epfd, fs::OpenFile::Flags{})
+        );
+        if (!epoll)
+            throw std::invalid_argument("Not an epoll file descriptor");
+
+        return epoll;
+    }
+}
+
+async::future<int> poll(std::weak_ptr<process::Process> process, memory::vaddr_t fds, nfds_t nfds, int timeout) {
+    if (nfds > fs::MAX_FILE_DESCRIPTORS)
+        throw std::invalid_argument("Too many file descriptors");
+
+    return memory::UserMemory(process, fds).get<pollfd>(nfds).then([process, fds, timeout](auto pollfds) {
+        auto _pollfds = std::make_shared<std::vector<pollfd>>(pollfds.get());
+
+        // Null for ones that are ignored or invalid
+        std::vector<std::shared_ptr<fs::File>> files;
+        std::vector<std::shared_ptr<fs::File>> validFiles;
+        for (const auto& pollfd : *_pollfds) {
+            std::shared_ptr<fs::File> file;
+            if (pollfd.fd >= 0) {
+                try {
+                    file = std::shared_ptr<process::Process>(process)->fdTable.get(pollfd.fd, fs::OpenFile::Flags{});
+                    validFiles.push_back(file);
+                } catch (const std::system_error&) {
+                    // Reported as POLLNVAL
+                }
+            }
+            files.push_back(std::move(file));
+        }
+
+        auto check = [_pollfds, files] {
+            int readyCount = 0;
+            for (size_t n = 0; n < files.size(); ++n) {
+                auto& pollfd = (*_pollfds)[n];
+                if (files[n])
+                    pollfd.revents = files[n]->getReadiness() & (pollfd.events | POLLERR | POLLHUP);
+                else
+                    pollfd.revents = pollfd.fd >= 0 ? POLLNVAL : 0;
+
+                if (pollfd.revents)
+                    ++readyCount;
+            }
+            return readyCount;
+        };
+
+        return fs::waitForReadiness(std::move(validFiles), check, timeout).then([process, fds, _pollfds](auto readyCount) {
+            int _readyCount = readyCount.get();
+            return memory::UserMemory(process, fds).write(_pollfds->data(), _pollfds->data() + _pollfds->size())
+                .then([_pollfds, _readyCount](async::future<void> result) {
+                    result.get();
+                    return _readyCount;
+                });
+        }).unwrap();
+    }).unwrap();
+}
+
+async::future<int> epoll_create(std::weak_ptr<process::Process> process, int size) {
+    if (size <= 0)
+        throw std::invalid_argument("Invalid size");
+
+    return syscall::epoll_create1(process, 0);
+}
+
+async::future<int> epoll_create1(std::weak_ptr<process::Process> process, int flags) {
+    if (flags & ~EPOLL_CLOEXEC)
+        throw std::invalid_argument("Invalid flags");
+
+    return async::make_ready_future(std::shared_ptr<process::Process>(process)->fdTable.insert(std::make_shared<fs::OpenFile>(
+        std::make_shared<fs::EventPoll>(),
+        fs::OpenFile::Flags{.read = true, .write = false}
+    ), flags & EPOLL_CLOEXEC));
+}
+
+async::future<int> epoll_ctl(std::weak_ptr<process::Process> process, int epfd, int op, int fd, memory::vaddr_t event) {
+    auto epoll = _getEventPoll(process, epfd);
+    auto file = std::shared_ptr<process::Process>(process)->fdTable.get(fd, fs::OpenFile::Flags{});
+
+    if (op == EPOLL_CTL_DEL) {
+        epoll->remove(fd, file);
+        return async::make_ready_future(0);
+    } else if (op != EPOLL_CTL_ADD && op != EPOLL_CTL_MOD) {
+        throw std::invalid_argument("Invalid operation");
+    }
+
+    return memory::UserMemory(process, event).get<epoll_event>().then([epoll, op, fd, file](auto event) {
+        if (op == EPOLL_CTL_ADD)
+            epoll->add(fd, file, event.get());
+        else
+            epoll->modify(fd, file, event.get());
+        return 0;
+    });
+}
+
+async::future<int> epoll_wait(std::weak_ptr<process::Process> process, int epfd, memory::vaddr_t events, int maxevents, int timeout) {
+    if (maxevents <= 0)
+        throw std::invalid_argument("Invalid maximum number of events");
+
+    auto epoll = _getEventPoll(process, epfd);
+    auto readyEvents = std::make_shared<std::vector<epoll_event>>();
+    auto check = [epoll, readyEvents, maxevents] {
+        *readyEvents = epoll->getReadyEvents(maxevents);
+        return static_cast<int>(readyEvents->size());
+    };
+
+    // Waiting on the epoll instance rather than on its files directly picks
+    // up files added to it in the meantime
+    return fs::waitForReadiness({epoll}, check, timeout).then([process, events, readyEvents](auto readyCount) {
+        int _readyCount = readyCount.get();
+        return memory::UserMemory(process, events).write(readyEvents->data(), readyEvents->data() + readyEvents->size())
+            .then([readyEvents, _readyCount](async::future<void> result) {
+                result.get();
+                return _readyCount;
+            });
+    }).unwrap();
+}
+
+}
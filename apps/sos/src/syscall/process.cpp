@@ -3,8 +3,9 @@
 #include <stdexcept>
 #include <system_error>
 
+#include <sys/resource.h>
+
 extern "C" {
-    #include <cpio/cpio.h>
     #include <sos.h>
 
     #include "internal/sys/debug.h"
@@ -18,10 +19,19 @@ extern "C" {
 #include "internal/syscall/process.h"
 #include "internal/syscall/thread.h"
 
-extern char _cpio_archive[];
-
 namespace syscall {
 
+namespace {
+    std::shared_ptr<process::Process> _getPriorityTarget(std::weak_ptr<process::Process> process, int which, id_t who) {
+        if (which != PRIO_PROCESS)
+            throw std::system_error(ENOSYS, std::system_category(), "Only process priorities are supported");
+
+        if (who == 0)
+            return std::shared_ptr<process::Process>(process);
+        return process::ThreadTable::get().get(who)->getProcess();
+    }
+}
+
 async::future<pid_t> getpid(std::weak_ptr<process::Process> process) {
     return async::make_ready_future(std::shared_ptr<process::Process>(process)->getPid());
 }
@@ -104,35 +114,51 @@ async::future<int> kill(std::weak_ptr<process::Process> process, pid_t pid, int
     if (pid < 1)
         throw std::system_error(ENOSYS, std::system_category(), "Killing multiple processes at once is not supported");
 
-    // TODO: Only supports single-threaded processes
     return syscall::tgkill(process, pid, pid, signal);
 }
 
 async::future<int> exit_group(std::weak_ptr<process::Process> process, int /*status*/) {
     // TODO: Exit codes are not supported
-    for (auto thread : std::shared_ptr<process::Process>(process)->getThreads()) {
-        auto _thread = thread.lock();
-        assert(_thread);
-        _thread->kill();
-    }
+    std::shared_ptr<process::Process>(process)->kill();
 
     return async::make_exceptional_future<int>(std::logic_error("Returned from syscall::exit_group()???"));
 }
 
+async::future<int> getpriority(std::weak_ptr<process::Process> process, int which, id_t who) {
+    // Offset like Linux' system call, so it's never negative. The C library
+    // converts it back
+    return async::make_ready_future(20 - _getPriorityTarget(process, which, who)->getNice());
+}
+
+async::future<int> setpriority(std::weak_ptr<process::Process> process, int which, id_t who, int prio) {
+    auto target = _getPriorityTarget(process, which, who);
+    if (target->isSosProcess)
+        throw std::system_error(EPERM, std::system_category(), "Can't change SOS's priority");
+
+    target->setNice(prio);
+    return async::make_ready_future(0);
+}
+
+async::future<int> nice(std::weak_ptr<process::Process> process, int increment) {
+    auto _process = std::shared_ptr<process::Process>(process);
+
+    // Clamped first so it can't overflow
+    increment = std::max(process::MIN_NICE - process::MAX_NICE, std::min(increment, process::MAX_NICE - process::MIN_NICE));
+    _process->setNice(_process->getNice() + increment);
+    return async::make_ready_future(0);
+}
+
 async::future<pid_t> process_create(std::weak_ptr<process::Process> process, memory::vaddr_t filename) {
-    // exec-like in that fds are copied from parent to child
+    // exec-like in that fds are copied from parent to child, except for the
+    // close-on-exec ones
     auto newProcess = process::Process::create(std::shared_ptr<process::Process>(process));
     return memory::UserMemory(process, filename).readString().then([=](auto filename) {
         newProcess->filename = std::move(filename.get());
-
-        unsigned long elf_size;
-        uint8_t* elf_base = (uint8_t*)cpio_get_file(_cpio_archive, newProcess->filename.c_str(), &elf_size);
-        if (!elf_base)
-            throw std::system_error(ENOENT, std::system_category(), "Unable to locate cpio header");
-
-        return elf::load(newProcess, elf_base);
+        return elf::open(newProcess->filename);
+    }).unwrap().then([=](auto image) {
+        return elf::load(newProcess, image.get());
     }).unwrap().then([=](auto ep) {
-        newProcess->fdTable = std::shared_ptr<process::Process>(process)->fdTable;
+        newProcess->fdTable = std::shared_ptr<process::Process>(process)->fdTable.forExec();
 
         auto newThread = process::Thread::create(newProcess);
         pid_t tid = process::ThreadTable::get().insert(newThread);
@@ -165,9 +191,9 @@ async::future<int> sos_process_status(std::weak_ptr<process::Process> process, m
                 if (n >= max)
                     break;
 
-                // XXX: Assumes single-threaded processes and pid = tid
+                // Each process is listed under its first thread
                 auto process = thread.second->getProcess();
-                if (process->isZombie())
+                if (thread.first != process->getPid() || process->isZombie())
                     continue;
 
                 using namespace std::chrono;
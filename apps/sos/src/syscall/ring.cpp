@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <assert.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#include "internal/memory/UserMemory.h"
+#include "internal/memory/layout.h"
+#include "internal/syscall/ring.h"
+#include "internal/stats.h"
+
+namespace syscall {
+
+namespace {
+    constexpr uint32_t RING_MASK = SOS_RING_ENTRIES - 1;
+    static_assert((SOS_RING_ENTRIES & RING_MASK) == 0, "Ring size must be a power of two");
+    static_assert(sizeof(sos_ring_t) <= PAGE_SIZE, "Rings must fit in a page");
+
+    // Anything that acts on the calling thread or replaces the process has
+    // to be a real syscall
+    bool _isRingSyscall(seL4_Word number) noexcept {
+        switch (number) {
+            case SYS_stat64:
+            case SYS_open:
+            case SYS_close:
+
+            case SYS_read:
+            case SYS_readv:
+            case SYS_pread64:
+            case SYS_preadv:
+
+            case SYS_write:
+            case SYS_writev:
+            case SYS_pwrite64:
+            case SYS_pwritev:
+
+            case SYS_getdents64:
+
+            case SYS_clock_gettime:
+            case SYS_nanosleep:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+}
+
+Ring::Ring(sos_ring_t* shared, memory::ScopedMapping mapping) noexcept:
+    _shared(shared),
+    _mapping(std::move(mapping))
+{}
+
+async::future<int> Ring::enter(std::weak_ptr<process::Thread> thread, unsigned minComplete) {
+    if (minComplete > SOS_RING_ENTRIES)
+        throw std::invalid_argument("Waiting for more completions than fit in the ring");
+    if (_waiter && !_waiterThread.expired())
+        throw std::system_error(EBUSY, std::system_category(), "Already waiting on the ring");
+
+    std::weak_ptr<process::Process> process = std::shared_ptr<process::Thread>(thread)->getProcess();
+
+    uint32_t sqTail = __atomic_load_n(&_shared->sq_tail, __ATOMIC_ACQUIRE);
+    if (sqTail - _sqHead > SOS_RING_ENTRIES)
+        throw std::invalid_argument("Corrupted submission ring");
+
+    // Only start as many as there is guaranteed to be room to complete
+    while (_sqHead != sqTail && _inFlight + _getCompleted() < SOS_RING_ENTRIES) {
+        // Copy it out first, since the process can change it under us
+        sos_ring_sqe_t sqe = _shared->sq[_sqHead & RING_MASK];
+        ++_sqHead;
+        __atomic_store_n(&_shared->sq_head, _sqHead, __ATOMIC_RELEASE);
+
+        _start(process, sqe);
+    }
+
+    if (_getCompleted() >= minComplete)
+        return async::make_ready_future(static_cast<int>(_getCompleted()));
+
+    // Breaks the promise of a waiter whose thread is already gone, which
+    // frees its saved reply cap
+    _waiter = std::make_unique<async::promise<int>>();
+    _waiterThread = thread;
+    _waiterMinComplete = minComplete;
+    return _waiter->get_future();
+}
+
+void Ring::cancelWait(const process::Thread& thread) noexcept {
+    if (!_waiter || _waiterThread.lock().get() != &thread)
+        return;
+
+    // Dropping the waiter breaks its promise, which frees the saved reply cap
+    auto waiter = std::move(_waiter);
+    _waiterThread.reset();
+}
+
+void Ring::_start(std::weak_ptr<process::Process> process, sos_ring_sqe_t sqe) {
+    timer::Timestamp start = timer::getTimestamp();
+    async::future<int> result;
+    try {
+        if (!_isRingSyscall(sqe.number))
+            throw std::system_error(ENOSYS, std::system_category(), "Syscall cannot be submitted through the ring");
+
+        result = handle(process, sqe.number, SOS_RING_MAX_ARGS, sqe.args);
+    } catch (...) {
+        result = async::make_exceptional_future<int>(std::current_exception());
+    }
+
+    ++_inFlight;
+    std::weak_ptr<Ring> ring = shared_from_this();
+    seL4_Word userData = sqe.user_data;
+    long number = sqe.number;
+    result.then([ring, userData, number, start](async::future<int> result) noexcept {
+        // Nothing to do if the process is already gone
+        std::shared_ptr<Ring> _ring = ring.lock();
+        if (!_ring)
+            return;
+
+        int value;
+        try {
+            value = result.get();
+            stats::recordSyscall(number, timer::getTimestamp() - start, false);
+        } catch (...) {
+            value = -exceptionToErrno(std::current_exception());
+            stats::recordSyscall(number, timer::getTimestamp() - start, true);
+        }
+        _ring->_complete(userData, value);
+    });
+}
+
+void Ring::_complete(seL4_Word userData, int result) noexcept {
+    assert(_inFlight > 0);
+    --_inFlight;
+
+    _shared->cq[_cqTail & RING_MASK] = sos_ring_cqe_t{
+        .user_data = userData,
+        .result = result
+    };
+    ++_cqTail;
+    __atomic_store_n(&_shared->cq_tail, _cqTail, __ATOMIC_RELEASE);
+
+    if (_waiter && _getCompleted() >= _waiterMinComplete) {
+        auto waiter = std::move(_waiter);
+        _waiterThread.reset();
+        waiter->set_value(static_cast<int>(_getCompleted()));
+    }
+}
+
+uint32_t Ring::_getCompleted() const noexcept {
+    return _cqTail - __atomic_load_n(&_shared->cq_head, __ATOMIC_ACQUIRE);
+}
+
+async::future<int> sos_ring_setup(std::weak_ptr<process::Process> process) {
+    std::shared_ptr<process::Process> _process(process);
+    if (_process->ring)
+        throw std::system_error(EEXIST, std::system_category(), "Rings already set up");
+
+    auto map = std::make_shared<memory::ScopedMapping>(_process->maps.insert(
+        0, 1,
+        memory::Attributes{.read = true, .write = true},
+        memory::Mapping::Flags{.shared = false}
+    ));
+
+    // XXX: We shouldn't reserve pages, but currently our page table layout
+    // requires this
+    _process->pageDirectory.reservePages(map->getStart(), map->getEnd());
+
+    // The page is freshly zero filled, so the rings start out empty
+    return memory::UserMemory(process, map->getStart())
+        .mapIn<sos_ring_t>(1, memory::Attributes{.read = true, .write = true})
+        .then([process, map](auto shared) {
+            auto _shared = shared.get();
+
+            std::shared_ptr<process::Process> _process(process);
+            if (_process->ring)
+                throw std::system_error(EEXIST, std::system_category(), "Rings already set up");
+            _process->ring = std::make_shared<Ring>(_shared.first, std::move(_shared.second));
+
+            int result = static_cast<int>(map->getStart());
+            map->release();
+            return result;
+        });
+}
+
+async::future<int> sos_ring_enter(std::weak_ptr<process::Thread> thread, unsigned minComplete) {
+    std::shared_ptr<Ring> ring = std::shared_ptr<process::Thread>(thread)->getProcess()->ring;
+    if (!ring)
+        throw std::system_error(EINVAL, std::system_category(), "Rings not set up");
+
+    return ring->enter(thread, minComplete);
+}
+
+void cancelRingWait(process::Thread& thread) noexcept {
+    if (auto ring = thread.getProcess()->ring)
+        ring->cancelWait(thread);
+}
+
+}
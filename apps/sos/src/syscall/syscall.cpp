@@ -12,8 +12,11 @@ extern "C" {
 }
 
 #include "internal/syscall/fs.h"
+#include "internal/syscall/futex.h"
 #include "internal/syscall/mmap.h"
+#include "internal/syscall/poll.h"
 #include "internal/syscall/process.h"
+#include "internal/syscall/ring.h"
 #include "internal/syscall/syscall.h"
 #include "internal/syscall/time.h"
 #include "internal/syscall/thread.h"
@@ -32,11 +35,37 @@ namespace {
         seL4_Word, seL4_Word, seL4_Word, seL4_Word
     );
 
+    using InlineSyscall = async::future<int> (*)(
+        std::weak_ptr<process::Thread>,
+        size_t, const seL4_Word*
+    );
+
+    constexpr InlineSyscall _getInlineSyscall(long number) {
+        #define ADD_SYSCALL(name) if (number == SYS_##name) return syscall::name
+
+        // fs
+        ADD_SYSCALL(sos_inline_stat64);
+        ADD_SYSCALL(sos_inline_open);
+        ADD_SYSCALL(sos_inline_read);
+        ADD_SYSCALL(sos_inline_write);
+
+        #undef ADD_SYSCALL
+        return nullptr;
+    }
+
     constexpr ThreadSyscall _getThreadSyscall(long number) {
         #define ADD_SYSCALL(name) if (number == SYS_##name) return reinterpret_cast<ThreadSyscall>(syscall::name)
 
+        // futex
+        ADD_SYSCALL(futex);
+
+        // ring
+        ADD_SYSCALL(sos_ring_enter);
+
         // thread
+        ADD_SYSCALL(clone);
         ADD_SYSCALL(gettid);
+        ADD_SYSCALL(set_tid_address);
         ADD_SYSCALL(exit);
 
         #undef ADD_SYSCALL
@@ -51,6 +80,12 @@ namespace {
         ADD_SYSCALL(open);
         ADD_SYSCALL(close);
 
+        ADD_SYSCALL(pipe);
+        ADD_SYSCALL(pipe2);
+        ADD_SYSCALL(dup);
+        ADD_SYSCALL(dup2);
+        ADD_SYSCALL(dup3);
+
         ADD_SYSCALL(read);
         ADD_SYSCALL(readv);
         ADD_SYSCALL(pread64);
@@ -61,6 +96,9 @@ namespace {
         ADD_SYSCALL(pwrite64);
         ADD_SYSCALL(pwritev);
 
+        ADD_SYSCALL(sendfile64);
+        ADD_SYSCALL(copy_file_range);
+
         ADD_SYSCALL(getdents64);
 
         ADD_SYSCALL(fcntl64);
@@ -71,15 +109,28 @@ namespace {
         ADD_SYSCALL(mmap2);
         ADD_SYSCALL(munmap);
 
+        // poll
+        ADD_SYSCALL(poll);
+        ADD_SYSCALL(epoll_create);
+        ADD_SYSCALL(epoll_create1);
+        ADD_SYSCALL(epoll_ctl);
+        ADD_SYSCALL(epoll_wait);
+
         // process
         ADD_SYSCALL(getpid);
         ADD_SYSCALL(waitid);
         ADD_SYSCALL(wait4);
         ADD_SYSCALL(kill);
         ADD_SYSCALL(exit_group);
+        ADD_SYSCALL(getpriority);
+        ADD_SYSCALL(setpriority);
+        ADD_SYSCALL(nice);
         ADD_SYSCALL(process_create);
         ADD_SYSCALL(sos_process_status);
 
+        // ring
+        ADD_SYSCALL(sos_ring_setup);
+
         // time
         ADD_SYSCALL(clock_gettime);
         ADD_SYSCALL(nanosleep);
@@ -94,7 +145,9 @@ namespace {
 }
 
 async::future<int> handle(std::weak_ptr<process::Thread> thread, long number, size_t argc, seL4_Word* argv) {
-    if (_getThreadSyscall(number)) {
+    if (_getInlineSyscall(number)) {
+        return _getInlineSyscall(number)(thread, argc, argv);
+    } else if (_getThreadSyscall(number)) {
         seL4_Word args[8] = {0};
         std::copy(argv, argv + std::min(argc, 8U), args);
 
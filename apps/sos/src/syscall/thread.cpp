@@ -1,27 +1,82 @@
 #include <stdexcept>
 #include <system_error>
 
+#include <sched.h>
 #include <signal.h>
 
+#include "internal/globals.h"
+#include "internal/memory/UserMemory.h"
 #include "internal/process/Table.h"
 #include "internal/syscall/thread.h"
 
 namespace syscall {
 
+async::future<pid_t> clone(std::weak_ptr<process::Thread> thread, int flags, memory::vaddr_t stack, memory::vaddr_t parentTid, seL4_Word threadPointer, memory::vaddr_t childTid, memory::vaddr_t entryPoint) {
+    // Without copy-on-write there's no fork(), so only threads in the same
+    // process can be created
+    constexpr int THREAD_FLAGS = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD;
+    constexpr int SUPPORTED_FLAGS = THREAD_FLAGS | CLONE_SYSVSEM | CLONE_SETTLS |
+        CLONE_PARENT_SETTID | CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID | CLONE_DETACHED;
+    if ((flags & THREAD_FLAGS) != THREAD_FLAGS)
+        throw std::system_error(ENOSYS, std::system_category(), "Only creating threads is supported");
+    if (flags & ~SUPPORTED_FLAGS)
+        throw std::invalid_argument("Unsupported flags");
+    if (!stack)
+        throw std::invalid_argument("New threads need their own stack");
+    if (!(flags & CLONE_SETTLS))
+        threadPointer = 0;
+
+    auto process = std::shared_ptr<process::Thread>(thread)->getProcess();
+    auto newThread = process::Thread::create(process);
+    if (flags & CLONE_CHILD_CLEARTID)
+        newThread->setClearChildTid(childTid);
+
+    pid_t tid = process::ThreadTable::get().insert(newThread);
+    try {
+        // Both are in the same address space, and have to be set before
+        // either thread carries on
+        auto setParentTid = async::make_ready_future();
+        if (flags & CLONE_PARENT_SETTID)
+            setParentTid = memory::UserMemory(process, parentTid).set(tid);
+
+        return setParentTid.then([=](async::future<void> result) {
+            result.get();
+            if (flags & CLONE_CHILD_SETTID)
+                return memory::UserMemory(process, childTid).set(tid);
+            return async::make_ready_future();
+        }).unwrap().then([=](async::future<void> result) {
+            result.get();
+            return newThread->start(tid, getIpcEndpoint(), tid, entryPoint, stack, stack, threadPointer);
+        }).unwrap().then([=](async::future<void> result) {
+            try {
+                result.get();
+                return tid;
+            } catch (...) {
+                process::ThreadTable::get().erase(tid);
+                throw;
+            }
+        });
+    } catch (...) {
+        process::ThreadTable::get().erase(tid);
+        throw;
+    }
+}
+
 async::future<pid_t> gettid(std::weak_ptr<process::Thread> thread) {
     return async::make_ready_future(std::shared_ptr<process::Thread>(thread)->getTid());
 }
 
+async::future<pid_t> set_tid_address(std::weak_ptr<process::Thread> thread, memory::vaddr_t address) {
+    auto _thread = std::shared_ptr<process::Thread>(thread);
+    _thread->setClearChildTid(address);
+    return async::make_ready_future(_thread->getTid());
+}
+
 async::future<int> tkill(std::weak_ptr<process::Process> process, pid_t tid, int signal) {
-    // XXX: Assumes single-threaded processes where pid = tid
-    return syscall::tgkill(process, tid, tid, signal);
+    return syscall::tgkill(process, process::ThreadTable::get().get(tid)->getProcess()->getPid(), tid, signal);
 }
 
 async::future<int> tgkill(std::weak_ptr<process::Process> process, pid_t tgid, pid_t tid, int signal) {
-    // XXX: Assumes single-threaded processes where pid = tid
-    if (tgid != tid)
-        throw std::system_error(ESRCH, std::system_category());
-
     if (signal != 0 && signal != SIGKILL)
         throw std::invalid_argument("Only SIGKILL is currently supported");
 
@@ -36,15 +91,21 @@ async::future<int> tgkill(std::weak_ptr<process::Process> process, pid_t tgid, p
         if (signal != 0)
             _exit(1);
     } else {
-        auto thread = process::ThreadTable::get().get(tid);
+        auto targetProcess = process::ThreadTable::get().get(tid)->getProcess();
+        if (targetProcess->getPid() != tgid)
+            throw std::system_error(ESRCH, std::system_category());
+
+        // SIGKILL takes the whole process with it, whichever thread it's
+        // sent to
         if (signal != 0)
-            thread->kill();
+            targetProcess->kill();
     }
 
     return async::make_ready_future(0);
 }
 
 async::future<int> exit(std::weak_ptr<process::Thread> thread, int /*status*/) {
+    // Only the calling thread, unless it's the last one
     // TODO: Exit codes are not supported
     std::shared_ptr<process::Thread>(thread)->kill();
 
@@ -58,7 +119,7 @@ extern "C" int sys_gettid() {
 }
 
 extern "C" void sys_exit(va_list ap) {
-    // We don't support multithreading, so just exit the entire process
+    // SOS itself only has the one thread, so just exit the entire process
     _exit(va_arg(ap, int));
 }
 
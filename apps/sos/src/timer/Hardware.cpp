@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <string>
 #include <system_error>
+#include <stddef.h>
 #include <stdint.h>
 
 extern "C" {
@@ -121,6 +122,13 @@ Timestamp Hardware::getNextIrqTime() const noexcept {
         return _counterZeroTimestamp + microseconds(0x100000000);
 }
 
+void Hardware::describe(sos_time_page_t& page) const noexcept {
+    page.counter_zero = _counterZeroTimestamp.time_since_epoch().count();
+    page.counter_offset = offsetof(Registers, counter);
+    page.status_offset = offsetof(Registers, status);
+    page.overflow_mask = GPT1_SR_ROV;
+}
+
 void Hardware::handleIrq() noexcept {
     if (_registers->status & GPT1_SR_ROV)
         _counterZeroTimestamp += microseconds(0x100000000);
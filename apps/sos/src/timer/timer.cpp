@@ -6,10 +6,13 @@
 
 extern "C" {
     #include <sel4/types.h>
+    #include <sos.h>
 
     #include "internal/sys/debug.h"
 }
 
+#include "internal/memory/PageDirectory.h"
+#include "internal/process/Thread.h"
 #include "internal/timer/Hardware.h"
 #include "internal/timer/timer.h"
 
@@ -37,11 +40,44 @@ namespace {
     std::set<TimerId> toRemove;
 
     std::priority_queue<Interrupt> interrupts;
+
+    std::unique_ptr<memory::ScopedMapping> timePageMapping;
+    sos_time_page_t* timePage;
+
+    void _publishTime() noexcept {
+        // Odd while we're updating, so processes know to retry
+        __atomic_store_n(&timePage->sequence, timePage->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        hardware->describe(*timePage);
+
+        __atomic_store_n(&timePage->sequence, timePage->sequence + 1, __ATOMIC_RELEASE);
+    }
 }
 
 void init(Capability<seL4_AsyncEndpointObject, seL4_EndpointBits> irqEndpoint) {
     hardware = std::make_unique<timer::Hardware>(std::move(irqEndpoint));
     nextFree = 1;
+
+    memory::Attributes attributes = {
+        .read = true,
+        .write = true,
+        .execute = false,
+        .locked = true
+    };
+    auto sosProcess = process::getSosProcess();
+    timePageMapping = std::make_unique<memory::ScopedMapping>(sosProcess->maps.insert(
+        0, 1, attributes, memory::Mapping::Flags{.shared = false}
+    ));
+
+    // Nothing has used up memory this early, so the frame is always
+    // available straight away
+    auto page = sosProcess->pageDirectory.allocateAndMap(timePageMapping->getAddress(), attributes);
+    assert(page.is_ready());
+    page.get();
+
+    timePage = reinterpret_cast<sos_time_page_t*>(timePageMapping->getAddress());
+    _publishTime();
 }
 
 void deinit() noexcept {
@@ -49,6 +85,9 @@ void deinit() noexcept {
     toRemove.clear();
     timers.clear();
 
+    timePage = nullptr;
+    timePageMapping.reset();
+
     hardware.reset();
 }
 
@@ -91,7 +130,10 @@ void clearTimer(TimerId id) {
 }
 
 void handleIrq() noexcept {
+    // The counter might have overflowed
     hardware->handleIrq();
+    _publishTime();
+
     if (interrupts.empty())
         return;
 
@@ -129,4 +171,40 @@ void handleIrq() noexcept {
     hardware->requestNextIrqTime(nextInterrupt);
 }
 
+
+void mapTimePage(process::Process& process) {
+    static_assert(SOS_TIME_REGISTERS == SOS_TIME_PAGE + PAGE_SIZE, "Time page and registers must be contiguous");
+
+    // Reserved, so the page fault handler never tries to map anything else
+    // there
+    process.maps.insert(
+        SOS_TIME_PAGE, 2,
+        memory::Attributes{.read = true},
+        memory::Mapping::Flags{.shared = false, .fixed = true, .stack = false, .reserved = true}
+    ).release();
+
+    const auto& sosPageDirectory = process::getSosProcess()->pageDirectory;
+    process.pageDirectory.map(
+        sosPageDirectory.lookup(timePageMapping->getAddress())->getPage().copy(),
+        SOS_TIME_PAGE,
+        memory::Attributes{
+            .read = true,
+            .write = false,
+            .execute = false,
+            .locked = true
+        }
+    );
+    process.pageDirectory.map(
+        sosPageDirectory.lookup(hardware->getRegistersAddress())->getPage().copy(),
+        SOS_TIME_REGISTERS,
+        memory::Attributes{
+            .read = true,
+            .write = false,
+            .execute = false,
+            .locked = true,
+            .notCacheable = true
+        }
+    );
+}
+
 }
@@ -16,21 +16,19 @@
 
 #include "internal/sys/debug.h"
 
-#define BITS_PER_BYTE 8
-#define FLOOR(x)      ((x) & ~(BITS_PER_BYTE - 1))
-#define CEILING(x)    (FLOOR((x) + (BITS_PER_BYTE-1)))
+#define BITS_PER_WORD 32
+#define WORD_FULL     0xffffffffU
+#define WORDS(x)      (((x) + (BITS_PER_WORD - 1)) / BITS_PER_WORD)
 
 void debug_print(bitfield_t* bf){
 #if 0
-    int i, j;
-    for(i = 0, j=1; i < CEILING(bf->size)/BITS_PER_BYTE; i++, j++){
-        printf("%02x", bf->b[i]&0xff);
-        if(!(j & 0x3)){
-            printf(" ");
-        }
-        if(j == 4*8){
+    int i;
+    for(i = 0; i < WORDS(bf->size); i++){
+        printf("%08x", bf->w[i]);
+        if((i & 0x7) == 0x7){
             printf("\n");
-            j=0;
+        }else{
+            printf(" ");
         }
     }
     printf("\n\n");
@@ -41,7 +39,8 @@ void debug_print(bitfield_t* bf){
 
 bitfield_t* new_bitfield(int size, enum bf_init_state state){
     bitfield_t* bf;
-    int bytes;
+    int words;
+    int summary_words;
 
     /* Allocate memory */
     bf = (bitfield_t*)malloc(sizeof(bitfield_t));
@@ -49,9 +48,16 @@ bitfield_t* new_bitfield(int size, enum bf_init_state state){
         return NULL;
     }
 
-    bytes = CEILING(size)/BITS_PER_BYTE;
-    bf->b = (char*)malloc(bytes);
-    if(bf->b == NULL){
+    words = WORDS(size);
+    summary_words = WORDS(words);
+    bf->w = (uint32_t*)malloc(words * sizeof(uint32_t));
+    if(bf->w == NULL){
+        free(bf);
+        return NULL;
+    }
+    bf->summary = (uint32_t*)malloc(summary_words * sizeof(uint32_t));
+    if(bf->summary == NULL){
+        free(bf->w);
         free(bf);
         return NULL;
     }
@@ -61,84 +67,84 @@ bitfield_t* new_bitfield(int size, enum bf_init_state state){
     bf->next_free = 0;
     if(state == BITFIELD_INIT_FILLED){
         bf->available = 0;
-        memset(bf->b, 0xff, bytes);
+        memset(bf->w, 0xff, words * sizeof(uint32_t));
+        memset(bf->summary, 0xff, summary_words * sizeof(uint32_t));
     }else{
-        int i;
-
         bf->available = size;
-        memset(bf->b, 0x00, bytes);
+        memset(bf->w, 0x00, words * sizeof(uint32_t));
+        memset(bf->summary, 0x00, summary_words * sizeof(uint32_t));
 
-        /* mark overflow as used if the size is not a a multiple of 8 */
-        for(i = size; i < bytes * BITS_PER_BYTE; i++){
-            bf_set(bf, i);
+        /* mark overflow as used if the size is not a a multiple of 32 */
+        if(size % BITS_PER_WORD != 0){
+            bf->w[words - 1] = WORD_FULL << (size % BITS_PER_WORD);
         }
     }
 
+    /* Words past the end of the bitfield are always full */
+    if(words % BITS_PER_WORD != 0){
+        bf->summary[summary_words - 1] |= WORD_FULL << (words % BITS_PER_WORD);
+    }
+
     return bf;
 }
 
 void destroy_bitfield(bitfield_t* bf){
-    free(bf->b);
+    free(bf->summary);
+    free(bf->w);
     free(bf);
 }
 
 
-/* Find a byte that is not completely marked */
-static inline int _bf_find_next_free_byte(char* field, int next, int size){
+/* Find a word that is not completely marked, in the range [from, to) */
+static inline int _bf_find_free_word(const bitfield_t* bf, int from, int to){
     int current;
-    next = FLOOR(next)/BITS_PER_BYTE;
-    size = CEILING(size)/BITS_PER_BYTE;
 
-    /* Search from next to limit */
-    for(current = next; current < size; current++){
-        if(field[current] != 0xff){
-            return current;
-        }
-    }
+    current = from;
+    while(current < to){
+        uint32_t full = bf->summary[current / BITS_PER_WORD];
 
-    /* Search from limit to next */
-    for(current = 0; current < next; current++){
-        if(field[current] != 0xff){
-            return current;
+        /* Ignore the words before where we started */
+        full |= ~(WORD_FULL << (current % BITS_PER_WORD));
+        if(full != WORD_FULL){
+            int word = (current & ~(BITS_PER_WORD - 1)) + __builtin_ctz(~full);
+            return word < to ? word : -1;
         }
-    }
 
-    return -1;
-}
-
-/*
- * find a bit that is clear
- * @pre the byte must have a free bit
- */
-static inline int _bf_find_next_free_bit(char field){
-    int i;
-    assert(field != 0xff);
-    for(i = 0; i < BITS_PER_BYTE; i++){
-        if((field & (1 << i)) == 0){
-            return i;
-        }
+        current = (current & ~(BITS_PER_WORD - 1)) + BITS_PER_WORD;
     }
+
     return -1;
 }
 
 int bf_set_next_free(bitfield_t* bf){
     if(bf->available != 0){
-        int byte;
+        int words;
+        int next;
+        int word;
+
+        words = WORDS(bf->size);
+        next = bf->next_free;
+        if(next < 0 || next >= bf->size){
+            next = 0;
+        }
 
-        /* Bytewise search for != 0xff */
-        byte = _bf_find_next_free_byte(bf->b, bf->next_free, bf->size);
-        if(byte != -1){
-            int bit;
+        /* Search from next to limit, then from the start to next */
+        word = _bf_find_free_word(bf, next / BITS_PER_WORD, words);
+        if(word == -1){
+            word = _bf_find_free_word(bf, 0, next / BITS_PER_WORD + 1);
+        }
+
+        if(word != -1){
             int offset;
 
-            /* bitwise search within byte */
-            bit = _bf_find_next_free_bit(bf->b[byte]);
-            offset = (byte * BITS_PER_BYTE) + bit;
+            /* The lowest clear bit within the word */
+            assert(bf->w[word] != WORD_FULL);
+            offset = (word * BITS_PER_WORD) + __builtin_ctz(~bf->w[word]);
 
             /* mark and return */
             bf_set(bf, offset);
             bf->next_free = offset + 1;
-            if(bf->next_free > bf->size){
+            if(bf->next_free >= bf->size){
                 bf->next_free = 0;
             }
 
@@ -150,48 +156,51 @@ int bf_set_next_free(bitfield_t* bf){
 }
 
 
-static inline void _bf_decode(int offset, int* byte, int* bitmask){
-    int bit;
-    *byte = offset >> 3;
-    bit = offset & 0x7;
-
-    *bitmask = 1;
-    while(bit-- > 0){
-        *bitmask <<= 1;
-    }
+static inline void _bf_decode(int offset, int* word, uint32_t* bitmask){
+    *word = offset / BITS_PER_WORD;
+    *bitmask = 1U << (offset % BITS_PER_WORD);
 }
 
 
 void bf_set(bitfield_t* bf, int offset){
-    int byte, bitmask;
+    int word;
+    uint32_t bitmask;
 
     assert(!bf_get(bf, offset));
 
-    _bf_decode(offset, &byte, &bitmask);
+    _bf_decode(offset, &word, &bitmask);
 
-    assert(byte < CEILING(bf->size)/BITS_PER_BYTE);
-    bf->b[byte] |= bitmask;
+    assert(word < WORDS(bf->size));
+    bf->w[word] |= bitmask;
     bf->available--;
+
+    if(bf->w[word] == WORD_FULL){
+        bf->summary[word / BITS_PER_WORD] |= 1U << (word % BITS_PER_WORD);
+    }
 }
 
 void bf_clr(bitfield_t* bf, int offset){
-    int byte, bitmask;
+    int word;
+    uint32_t bitmask;
 
     assert(bf_get(bf, offset));
 
-    _bf_decode(offset, &byte, &bitmask);
+    _bf_decode(offset, &word, &bitmask);
 
-    assert(byte < CEILING(bf->size)/BITS_PER_BYTE);
-    bf->b[byte] &= ~bitmask;
+    assert(word < WORDS(bf->size));
+    bf->w[word] &= ~bitmask;
     bf->available++;
 
+    bf->summary[word / BITS_PER_WORD] &= ~(1U << (word % BITS_PER_WORD));
+
     debug_print(bf);
 }
 
 int bf_get(const bitfield_t* bf, int offset){
-    int byte, bitmask;
-    _bf_decode(offset, &byte, &bitmask);
+    int word;
+    uint32_t bitmask;
+    _bf_decode(offset, &word, &bitmask);
 
-    assert(byte < CEILING(bf->size)/BITS_PER_BYTE);
-    return (bf->b[byte] & bitmask) != 0;
+    assert(word < WORDS(bf->size));
+    return (bf->w[word] & bitmask) != 0;
 }
@@ -40,6 +40,21 @@ static seL4_Word _pool_base = 0;
 #define PRIMARY_POOL_SIZEBITS 14
 #define PRIMARY_POOL          _pool14
 
+/*
+ * Recently freed memory is kept in a small per-size stack (a magazine)
+ * instead of going straight back to the pools, so that the common pattern of
+ * freeing and then reallocating a frame or page table doesn't need to search
+ * the bitfields or merge and split slabs.
+ */
+#define MAGAZINE_SIZE 32
+
+typedef struct {
+    int count;
+    seL4_Word addrs[MAGAZINE_SIZE];
+} magazine_t;
+
+static magazine_t _magazines[PRIMARY_POOL_SIZEBITS + 1];
+
 
 /*********************
  *** bitfield pool ***
@@ -338,6 +353,58 @@ static void do_ut_free_from_list(seL4_Word addr, int sizebits){
 
 
 
+/****************
+ *** magazine ***
+ ****************/
+static int _magazine_size_valid(int sizebits){
+    switch(sizebits){
+    case 4:
+    case 9:
+    case 10:
+    case 12:
+    case 14:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static seL4_Word _magazine_pop(int sizebits){
+    magazine_t* magazine = &_magazines[sizebits];
+    if(magazine->count == 0){
+        return 0;
+    }
+    return magazine->addrs[--magazine->count];
+}
+
+static int _magazine_push(seL4_Word addr, int sizebits){
+    magazine_t* magazine = &_magazines[sizebits];
+    if(magazine->count == MAGAZINE_SIZE){
+        return 0;
+    }
+    magazine->addrs[magazine->count++] = addr;
+    return 1;
+}
+
+static void do_ut_free(seL4_Word addr, int sizebits);
+
+/* Returns all cached memory to the pools. Returns non-zero if there was any */
+static int _magazines_flush(void){
+    int flushed = 0;
+    int sizebits;
+
+    for(sizebits = 0; sizebits <= PRIMARY_POOL_SIZEBITS; sizebits++){
+        magazine_t* magazine = &_magazines[sizebits];
+        while(magazine->count > 0){
+            do_ut_free(magazine->addrs[--magazine->count], sizebits);
+            flushed = 1;
+        }
+    }
+
+    return flushed;
+}
+
+
 /**************************
  *** Exported functions ***
  **************************/
@@ -367,37 +434,23 @@ void ut_allocator_init(seL4_Word low, seL4_Word high){
     _initialised = 1;
 }
 
-seL4_Word ut_alloc(int sizebits){
-    seL4_Word addr;
-
-    assert(_initialised);
-
-    /* make sure that we are initialised */
-    assert(PRIMARY_POOL != NULL);
-
+static seL4_Word do_ut_alloc(int sizebits){
     /* forward to appropriate functions */
     switch(sizebits){
     case 4:
     case 9:
-        addr = do_ut_alloc_from_list(sizebits);
-        break;
+        return do_ut_alloc_from_list(sizebits);
     case 10:
     case 12:
     case 14:
-        addr = do_ut_alloc_from_bitfield(sizebits);
-        break;
+        return do_ut_alloc_from_bitfield(sizebits);
     default:
-        assert(!"ut_free received invalid size");
+        assert(!"ut_alloc received invalid size");
         return 0;
     }
-
-    return addr;
 }
 
-void ut_free(seL4_Word addr, int sizebits){
-    assert(addr != 0);
-    assert((addr & ((1 << sizebits) - 1)) == 0 || !"Address not aligned");
-
+static void do_ut_free(seL4_Word addr, int sizebits){
     /* forward to appropriate functions */
     switch(sizebits){
     case 4:
@@ -413,3 +466,45 @@ void ut_free(seL4_Word addr, int sizebits){
         assert(!"ut_free received invalid size");
     }
 }
+
+seL4_Word ut_alloc(int sizebits){
+    seL4_Word addr;
+
+    assert(_initialised);
+
+    /* make sure that we are initialised */
+    assert(PRIMARY_POOL != NULL);
+
+    if(!_magazine_size_valid(sizebits)){
+        assert(!"ut_alloc received invalid size");
+        return 0;
+    }
+
+    /* Reuse recently freed memory if we can */
+    addr = _magazine_pop(sizebits);
+    if(addr != 0){
+        return addr;
+    }
+
+    addr = do_ut_alloc(sizebits);
+    if(addr == 0 && _magazines_flush()){
+        /* The memory we need may have been sitting in other magazines */
+        addr = do_ut_alloc(sizebits);
+    }
+
+    return addr;
+}
+
+void ut_free(seL4_Word addr, int sizebits){
+    assert(addr != 0);
+    assert((addr & ((1 << sizebits) - 1)) == 0 || !"Address not aligned");
+
+    if(!_magazine_size_valid(sizebits)){
+        assert(!"ut_free received invalid size");
+        return;
+    }
+
+    if(!_magazine_push(addr, sizebits)){
+        do_ut_free(addr, sizebits);
+    }
+}
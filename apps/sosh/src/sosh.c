@@ -18,6 +18,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <utils/time.h>
 
@@ -25,7 +28,9 @@
 #include <sos.h>
 
 #define BUF_SIZ    6144
+#define COPY_SIZ   (1024 * 1024)
 #define MAX_ARGS   32
+#define MAX_STAGES 8
 
 static int in;
 static sos_stat_t sbuf;
@@ -42,8 +47,8 @@ static void prstat(const char *name) {
 
 static int cat(int argc, char **argv) {
     int fd;
-    char buf[BUF_SIZ];
-    int num_read, stdout_fd, num_written = 0;
+    off_t offset = 0;
+    ssize_t num_sent;
 
 
     if (argc != 2) {
@@ -52,18 +57,20 @@ static int cat(int argc, char **argv) {
     }
 
     printf("<%s>\n", argv[1]);
+    fflush(stdout);
 
     fd = open(argv[1], O_RDONLY);
-    stdout_fd = open("console", O_WRONLY);
 
     assert(fd >= 0);
 
-    while ((num_read = read(fd, buf, BUF_SIZ)) > 0)
-        num_written = write(stdout_fd, buf, num_read);
+    /* SOS streams the file straight to stdout, and since we give it the
+     * offset it can read ahead while writing */
+    while ((num_sent = sendfile(STDOUT_FILENO, fd, &offset, COPY_SIZ)) > 0)
+        ;
 
-    close(stdout_fd);
+    close(fd);
 
-    if (num_read == -1 || num_written == -1) {
+    if (num_sent == -1) {
         printf("error on write\n");
         return 1;
     }
@@ -74,8 +81,8 @@ static int cat(int argc, char **argv) {
 static int cp(int argc, char **argv) {
     int fd, fd_out;
     char *file1, *file2;
-    char buf[BUF_SIZ];
-    int num_read, num_written = 0;
+    off_t offset = 0;
+    ssize_t num_copied;
 
     if (argc != 3) {
         printf("Usage: cp from to\n");
@@ -90,10 +97,10 @@ static int cp(int argc, char **argv) {
 
     assert(fd >= 0);
 
-    while ((num_read = read(fd, buf, BUF_SIZ)) > 0)
-        num_written = write(fd_out, buf, num_read);
+    while ((num_copied = copy_file_range(fd, &offset, fd_out, NULL, COPY_SIZ, 0)) > 0)
+        ;
 
-    if (num_read == -1 || num_written == -1) {
+    if (num_copied == -1) {
         printf("error on cp\n");
         return 1;
     }
@@ -128,26 +135,29 @@ static int ps(int argc, char **argv) {
     return 0;
 }
 
-static int exec(int argc, char **argv) {
+static int run(const char *filename, int bg, int increment) {
     pid_t pid;
     int r;
-    int bg = 0;
+    int prio = 0;
 
-    if (argc < 2 || (argc > 2 && argv[2][0] != '&')) {
-        printf("Usage: exec filename [&]\n");
-        return 1;
+    if (bg == 0) {
+        r = close(in);
+        assert(r == 0);
     }
 
-    if ((argc > 2) && (argv[2][0] == '&')) {
-        bg = 1;
+    /* Children start with our nice value, so only change it around creating
+     * the child */
+    if (increment != 0) {
+        prio = getpriority(PRIO_PROCESS, 0);
+        r = setpriority(PRIO_PROCESS, 0, prio + increment);
+        assert(r == 0);
     }
-
-    if (bg == 0) {
-        r = close(in);
+    pid = sos_process_create(filename);
+    if (increment != 0) {
+        r = setpriority(PRIO_PROCESS, 0, prio);
         assert(r == 0);
     }
 
-    pid = sos_process_create(argv[1]);
     if (pid >= 0) {
         printf("Child pid=%d\n", pid);
         if (bg == 0) {
@@ -157,12 +167,30 @@ static int exec(int argc, char **argv) {
         printf("Failed!\n");
     }
     if (bg == 0) {
-        in = open("console", O_RDONLY);
+        in = open("console", O_RDONLY | O_CLOEXEC);
         assert(in >= 0);
     }
     return 0;
 }
 
+static int exec(int argc, char **argv) {
+    if (argc < 2 || (argc > 2 && argv[2][0] != '&')) {
+        printf("Usage: exec filename [&]\n");
+        return 1;
+    }
+
+    return run(argv[1], argc > 2, 0);
+}
+
+static int nice_exec(int argc, char **argv) {
+    if (argc < 3 || (argc > 3 && argv[3][0] != '&')) {
+        printf("Usage: nice increment filename [&]\n");
+        return 1;
+    }
+
+    return run(argv[2], argc > 3, atoi(argv[1]));
+}
+
 static int dir(int argc, char **argv) {
     int i = 0, r;
     char buf[BUF_SIZ];
@@ -250,6 +278,48 @@ static int kill(int argc, char *argv[]) {
     return sos_process_delete(pid);
 }
 
+static uint64_t nanos_since_boot(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * NS_IN_S + (uint64_t)ts.tv_nsec;
+}
+
+static int syscall_latency(int argc, char *argv[]) {
+    uint64_t start, end;
+    int i, iterations = 10000;
+
+    if (argc > 2) {
+        printf("Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            printf("Invalid iteration count\n");
+            return 1;
+        }
+    }
+
+    /* Round trip times of syscalls that SOS can answer straight away. The
+     * second goes through the per-thread syscall path rather than the
+     * per-process one */
+    start = nanos_since_boot();
+    for (i = 0; i < iterations; i++) {
+        sos_my_id();
+    }
+    end = nanos_since_boot();
+    printf("getpid: %llu ns per call\n", (end - start) / iterations);
+
+    start = nanos_since_boot();
+    for (i = 0; i < iterations; i++) {
+        syscall(SYS_gettid);
+    }
+    end = nanos_since_boot();
+    printf("gettid: %llu ns per call\n", (end - start) / iterations);
+
+    return 0;
+}
+
 struct command {
     char *name;
     int (*command)(int argc, char **argv);
@@ -257,7 +327,174 @@ struct command {
 
 struct command commands[] = { { "dir", dir }, { "ls", dir }, { "cat", cat }, {
         "cp", cp }, { "ps", ps }, { "exec", exec }, {"sleep",second_sleep}, {"msleep",milli_sleep},
-        {"time", second_time}, {"mtime", micro_time}, {"kill", kill} };
+        {"time", second_time}, {"mtime", micro_time}, {"kill", kill},
+        {"lat", syscall_latency}, {"nice", nice_exec} };
+
+static struct command *find_command(const char *name) {
+    int i;
+
+    for (i = 0; i < sizeof(commands) / sizeof(struct command); i++) {
+        if (strcmp(name, commands[i].name) == 0) {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+/* Makes "fd" available as "target" too, returning a close-on-exec copy of
+ * what "target" was before (or -1 if nothing) for restore_fd() */
+static int redirect_fd(int fd, int target) {
+    int saved;
+    int r;
+
+    saved = fcntl(target, F_DUPFD_CLOEXEC, 0);
+    r = dup2(fd, target);
+    assert(r == target);
+    return saved;
+}
+
+static void restore_fd(int saved, int target) {
+    int r;
+
+    if (saved == -1) {
+        close(target);
+        return;
+    }
+
+    r = dup2(saved, target);
+    assert(r == target);
+    close(saved);
+}
+
+/* Starts "path" with "fd_in" and "fd_out" as its stdin and stdout, or the
+ * same as ours if -1 */
+static pid_t spawn(const char *path, int fd_in, int fd_out) {
+    int saved_in = -1, saved_out = -1;
+    pid_t pid;
+
+    if (fd_in != -1) {
+        saved_in = redirect_fd(fd_in, STDIN_FILENO);
+    }
+    if (fd_out != -1) {
+        fflush(stdout);
+        saved_out = redirect_fd(fd_out, STDOUT_FILENO);
+    }
+
+    pid = sos_process_create(path);
+
+    if (fd_out != -1) {
+        restore_fd(saved_out, STDOUT_FILENO);
+    }
+    if (fd_in != -1) {
+        restore_fd(saved_in, STDIN_FILENO);
+    }
+    return pid;
+}
+
+/* Runs "stage | program | ... [&]", connecting each stage's stdout to the
+ * next one's stdin with a pipe. Built-in commands don't read their stdin, so
+ * only the first stage can be one, and it runs in the shell itself once the
+ * programs reading from it have started */
+static int pipeline(int argc, char **argv) {
+    char **stage_argv[MAX_STAGES];
+    int stage_argc[MAX_STAGES];
+    pid_t pids[MAX_STAGES];
+    int nstages = 0, npids = 0;
+    struct command *builtin;
+    int builtin_out = -1;
+    int fd_in = -1, fds[2];
+    int bg = 0;
+    int i, r, start = 0;
+
+    if (strcmp(argv[argc - 1], "&") == 0) {
+        bg = 1;
+        argc--;
+    }
+
+    for (i = 0; i <= argc; i++) {
+        if (i < argc && strcmp(argv[i], "|") != 0) {
+            continue;
+        }
+        if (i == start || nstages == MAX_STAGES) {
+            printf("Usage: command | program [| program ...] [&]\n");
+            return 1;
+        }
+        stage_argv[nstages] = argv + start;
+        stage_argc[nstages] = i - start;
+        nstages++;
+        start = i + 1;
+    }
+
+    builtin = find_command(stage_argv[0][0]);
+    for (i = builtin ? 1 : 0; i < nstages; i++) {
+        if (stage_argc[i] != 1 || find_command(stage_argv[i][0])) {
+            printf("\"%s\" must be a program without arguments\n", stage_argv[i][0]);
+            return 1;
+        }
+    }
+
+    if (bg == 0) {
+        r = close(in);
+        assert(r == 0);
+    }
+
+    for (i = 0; i < nstages; i++) {
+        int fd_out = -1;
+
+        if (i < nstages - 1) {
+            if (pipe2(fds, O_CLOEXEC) != 0) {
+                printf("pipe failed\n");
+                break;
+            }
+            fd_out = fds[1];
+        }
+
+        if (i == 0 && builtin) {
+            builtin_out = fd_out;
+        } else {
+            pids[npids] = spawn(stage_argv[i][0], fd_in, fd_out);
+            if (pids[npids] >= 0) {
+                printf("Child pid=%d\n", pids[npids]);
+                npids++;
+            } else {
+                printf("Failed to start %s\n", stage_argv[i][0]);
+            }
+
+            if (fd_out != -1) {
+                close(fd_out);
+            }
+        }
+
+        if (fd_in != -1) {
+            close(fd_in);
+        }
+        fd_in = fd_out != -1 ? fds[0] : -1;
+    }
+    if (fd_in != -1) {
+        close(fd_in);
+    }
+
+    if (builtin_out != -1) {
+        int saved_out;
+
+        fflush(stdout);
+        saved_out = redirect_fd(builtin_out, STDOUT_FILENO);
+        close(builtin_out);
+        builtin->command(stage_argc[0], stage_argv[0]);
+        fflush(stdout);
+        restore_fd(saved_out, STDOUT_FILENO);
+    }
+
+    if (bg == 0) {
+        for (i = 0; i < npids; i++) {
+            sos_process_wait(pids[i]);
+        }
+
+        in = open("console", O_RDONLY | O_CLOEXEC);
+        assert(in >= 0);
+    }
+    return 0;
+}
 
 int main(void) {
     char buf[BUF_SIZ];
@@ -265,7 +502,7 @@ int main(void) {
     int i, r, done, found, new, argc;
     char *bp, *p;
 
-    in = open("console", O_RDONLY);
+    in = open("console", O_RDONLY | O_CLOEXEC);
     assert(in >= 0);
 
     bp = buf;
@@ -356,6 +593,13 @@ int main(void) {
             continue;
         }
 
+        for (i = 0; i < argc && strcmp(argv[i], "|") != 0; i++)
+            ;
+        if (i < argc) {
+            pipeline(argc, argv);
+            continue;
+        }
+
         found = 0;
 
         for (i = 0; i < sizeof(commands) / sizeof(struct command); i++) {
@@ -578,6 +578,8 @@ enum rpc_stat nfs_read(const fhandle_t *fh, int offset, int count,
  * has completed, the provided callback function (@ref nfs_write_cb_t) will be
  * called with "token" passed, unmodified, as an argument. The callback will
  * also be provided with the actual number of bytes written.
+ * The data is sent by reference rather than copied, so it must not be modified
+ * or freed until the callback has been called.
  * @param[in] fh       An NFS file handle (@ref fhandle_t) to the file which
  *                     should be written to.
  * @param[in] offset   The position, in bytes, at which to begin writing data.
@@ -299,6 +299,9 @@ nfs_read(const fhandle_t *fh, int offset, int count,
     return rpc_send(pbuf, pos, _nfs_pcb, &_nfs_read_cb, func, token);
 }
 
+/* XDR pads opaque data to a multiple of 4 bytes */
+static const uint8_t write_padding[sizeof(uint32_t)] = {0};
+
 struct write_token_wrapper {
     uintptr_t token;
     int count;
@@ -334,7 +337,7 @@ enum rpc_stat
 nfs_write(const fhandle_t *fh, int offset, int count, const void *data,
           nfs_write_cb_t func, uintptr_t token)
 {
-    struct pbuf *pbuf;
+    struct pbuf *pbuf, *data_pbuf, *pad_pbuf;
     struct write_token_wrapper *t;
     int pos;
     int err;
@@ -350,8 +353,7 @@ nfs_write(const fhandle_t *fh, int offset, int count, const void *data,
     }
 
     /* now the user data struct is setup, do some call stuff! */
-    size_t pbuf_size = sizeof(*fh) + 4 * sizeof(uint32_t) + count;
-    pb_alignul(&pbuf_size);
+    size_t pbuf_size = sizeof(*fh) + 4 * sizeof(uint32_t);
     pbuf = rpcpbuf_init(NFS_NUMBER, NFS_VERSION, NFSPROC_WRITE, pbuf_size, &pos);
     if(pbuf == NULL){
         free(t);
@@ -364,13 +366,38 @@ nfs_write(const fhandle_t *fh, int offset, int count, const void *data,
     pb_writel(pbuf, offset, &pos);
     pb_writel(pbuf, 0 /* Unused: see RFC */, &pos);
     pb_writel(pbuf, count, &pos);
-    pb_write(pbuf, data, count, &pos);
-    pb_alignl(&pos);
+    pbuf_realloc(pbuf, pos);
+
+    /* The data itself is referenced rather than copied, so the caller must
+     * keep it around until the callback is called */
+    if(count > 0){
+        data_pbuf = pbuf_alloc(PBUF_RAW, count, PBUF_REF);
+        if(data_pbuf == NULL){
+            pbuf_free(pbuf);
+            free(t);
+            return RPCERR_NOBUF;
+        }
+        data_pbuf->payload = (void*)data;
+        pbuf_cat(pbuf, data_pbuf);
+
+        size_t padded_count = count;
+        pb_alignul(&padded_count);
+        if(padded_count > count){
+            pad_pbuf = pbuf_alloc(PBUF_RAW, padded_count - count, PBUF_ROM);
+            if(pad_pbuf == NULL){
+                pbuf_free(pbuf);
+                free(t);
+                return RPCERR_NOBUF;
+            }
+            pad_pbuf->payload = (void*)write_padding;
+            pbuf_cat(pbuf, pad_pbuf);
+        }
+    }
 
     /* Wrap the token up ready for the call back */
     t->token = token;
     t->count = count;
-    err = rpc_send(pbuf, pos, _nfs_pcb, &_nfs_write_cb, func, (uintptr_t)t);
+    err = rpc_send(pbuf, pbuf->tot_len, _nfs_pcb, &_nfs_write_cb, func, (uintptr_t)t);
     if(err){
         free(t);
     }
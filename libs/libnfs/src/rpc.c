@@ -117,12 +117,17 @@ my_udp_send(struct udp_pcb* pcb, struct pbuf *pbuf)
 {
     int err;
     struct pbuf *p;
-    /* LWIP does not preserve the pbuf so make a copy first */
-    p = pbuf_new(pbuf->tot_len);
+    /* LWIP does not preserve the pbuf so make a copy first. Only the head
+     * gets its headers prepended though, so the rest of the chain (e.g. data
+     * referenced by nfs_write) can be shared between retransmissions */
+    p = pbuf_new(pbuf->len);
     if(p == NULL){
         return RPCERR_NOBUF;
     }
-    assert(!pbuf_copy(p, pbuf));
+    memcpy(p->payload, pbuf->payload, pbuf->len);
+    if(pbuf->next != NULL){
+        pbuf_chain(p, pbuf->next);
+    }
     err = udp_send(pcb, p);
     pbuf_free(p);
     switch(err){
@@ -293,11 +298,22 @@ rpc_send(struct pbuf *pbuf, int len, struct udp_pcb *pcb,
      void (*func)(void *, uintptr_t, struct pbuf *),
      void *callback, uintptr_t token)
 {
+    struct rpc_queue *q_item;
+    enum rpc_stat stat;
     assert(pcb);
     pbuf_realloc(pbuf, len);
     /* Add to a queue */
     add_to_queue(pbuf, pcb, func, callback, token);
-    return my_udp_send(pcb, pbuf);
+    stat = my_udp_send(pcb, pbuf);
+    if(stat){
+        /* The caller will clean up the callback arguments, so make sure
+         * we don't try to retransmit or call back with them later */
+        q_item = get_from_queue(extract_xid(pbuf));
+        assert(q_item);
+        pbuf_free(q_item->pbuf);
+        free(q_item);
+    }
+    return stat;
 }
 
 struct rpc_call_arg {
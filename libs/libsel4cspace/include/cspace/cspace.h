@@ -57,6 +57,9 @@
 /// The cnode size in actual number of slots.
 #define CSPACE_NODE_SIZE_IN_SLOTS (1 << CSPACE_NODE_SIZE_IN_SLOTS_BITS)
 
+/// The number of empty slots kept aside for saving reply caps
+#define CSPACE_REPLY_POOL_SIZE 32
+
 
 
 /**
@@ -72,6 +75,8 @@ typedef struct {
     int32_t next_level1_free_index;   /* the next free slot in the top level cnode */
     int32_t next_level2_free_slot;   /* the next free slot in leaf cnodes */
     uint32_t num_free_slots;    /* number of free slots, largely here for future use */
+    uint32_t num_reply_slots;   /* number of empty slots in the reply cap pool */
+    seL4_CPtr reply_slots[CSPACE_REPLY_POOL_SIZE]; /* empty slots reserved for reply caps */
     uint32_t level1_alloc_table[CSPACE_NODE_SIZE_IN_SLOTS]; /*
 							     * Either: 
 							     *  - A list of free level 1 slots, or 
@@ -295,12 +300,43 @@ extern seL4_CPtr cspace_alloc_slot(cspace_t *c);
  * capability in the slot (i.e. the slot is actually empty) and it does NOT perform a
  * cspace_delete_cap operation.
  *
- * This function is mainly used to free the slot used by the cspace_save_reply_cap() routine, as the
- * reply cap deletes itself when used.
+ * Slots used by the cspace_save_reply_cap() routine should be released with cspace_free_reply_cap()
+ * instead, which keeps them around for the next reply cap.
  */
 extern cspace_err_t cspace_free_slot(cspace_t *c, seL4_CPtr slot);
 
 
+/**
+ * Allocate several slots in the cspace at once.
+ *
+ * @param c The cspace
+ * @param n The number of slots to allocate
+ * @param slots An array of at least n entries to receive the slots
+ *
+ * @return Either CSPACE_ERROR or CSPACE_NOERROR
+ *
+ * Either all n slots are allocated or, on failure, none are (any slots already taken are handed
+ * back before returning). In a two-level cspace, room for all of them is made first and they are
+ * taken off the free list in a single pass.
+ */
+extern cspace_err_t cspace_alloc_slots(cspace_t *c, size_t n, seL4_CPtr *slots);
+
+
+/**
+ * Return several slots back to the cspace slot allocator.
+ *
+ * @param c The cspace
+ * @param n The number of slots to free
+ * @param slots The slots to free
+ *
+ * @return Either CSPACE_ERROR or CSPACE_NOERROR
+ *
+ * The same assumptions as cspace_free_slot() apply to every slot. In a two-level cspace, the
+ * slots are linked together and put back on the free list in a single pass.
+ */
+extern cspace_err_t cspace_free_slots(cspace_t *c, size_t n, const seL4_CPtr *slots);
+
+
 /**
  * Copy a capability from one cspace to the same or another cspace.
  *
@@ -459,12 +495,29 @@ extern seL4_CPtr cspace_rotate_cap(cspace_t *dest,
  * from the TCB into the destination cspace. This function implicitly allocates a slot to contain
  * the capability. 
  *
- * NOTE: If the cap is used for a reply, seL4 deletes the capability. cspace_free_slot() should be
- * used to de-allocate the now free slot from this libraries book keeping.
+ * The slot is taken from a small pool of empty slots kept by the cspace where possible, so the
+ * common case does not touch the slot allocator at all.
+ *
+ * NOTE: If the cap is used for a reply, seL4 deletes the capability. cspace_free_reply_cap() should
+ * be used to give the slot back to the pool once the reply has been sent (or abandoned).
  */
 extern seL4_CPtr cspace_save_reply_cap(cspace_t *dest);
 
 
+/**
+ * Release a slot obtained from cspace_save_reply_cap().
+ *
+ * @param c The cspace the reply cap was saved into.
+ * @param slot The slot returned by cspace_save_reply_cap().
+ *
+ * @return Either CSPACE_ERROR or CSPACE_NOERROR
+ *
+ * Any unused reply cap still in the slot is deleted, and the now empty slot is returned to the
+ * reply cap pool, or to the slot allocator if the pool is full.
+ */
+extern cspace_err_t cspace_free_reply_cap(cspace_t *c, seL4_CPtr slot);
+
+
 
 /**
  * Create an IRQ handler capability in the specified cspace.
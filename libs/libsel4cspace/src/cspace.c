@@ -74,6 +74,7 @@ cspace_err_t cspace_root_task_bootstrap(cspace_ut_alloc_t alloc_func,
     assert(space);
  
     space->levels = 2; /* root task cspace will be 2 levels */
+    space->num_reply_slots = 0;
     
     /* initialise the free level1 index list for list based allocation */
     for (i = 0; i < (CSPACE_NODE_SIZE_IN_SLOTS-1) ; i++) {
@@ -308,6 +309,7 @@ cspace_t *cspace_create(int levels) /* either 1 or 2 level */
     
     c = cspace_malloc(sizeof(cspace_t));
     assert(c != NULL);
+    c->num_reply_slots = 0;
     
     addr = cspace_ut_alloc(CSPACE_NODE_SIZE_IN_MEM_BITS);
     assert(addr != 0);
@@ -569,6 +571,47 @@ cspace_err_t cspace_free_slot(cspace_t *c, seL4_CPtr slot)
     return CSPACE_NOERROR;
 }
 
+cspace_err_t cspace_alloc_slots(cspace_t *c, size_t n, seL4_CPtr *slots)
+{
+    size_t i;
+    assert(c != NULL);
+    assert(slots != NULL || n == 0);
+
+    if (c->levels == 2) {
+        return cspace_alloc_level2_slots(c, n, slots);
+    }
+
+    for (i = 0; i < n; i++) {
+        slots[i] = cspace_alloc_slot(c);
+        if (slots[i] == CSPACE_NULL) {
+            /* all or nothing: hand back what we got so far */
+            cspace_free_slots(c, i, slots);
+            return CSPACE_ERROR;
+        }
+    }
+    return CSPACE_NOERROR;
+}
+
+cspace_err_t cspace_free_slots(cspace_t *c, size_t n, const seL4_CPtr *slots)
+{
+    size_t i;
+    cspace_err_t err = CSPACE_NOERROR;
+    assert(c != NULL);
+    assert(slots != NULL || n == 0);
+
+    if (c->levels == 2) {
+        return cspace_free_level2_slots(c, n, slots);
+    }
+
+    /* free in reverse so a following batch allocation gets the same slots back in order */
+    for (i = n; i > 0; i--) {
+        if (cspace_free_slot(c, slots[i - 1]) != CSPACE_NOERROR) {
+            err = CSPACE_ERROR;
+        }
+    }
+    return err;
+}
+
 seL4_Error cspace_ut_retype_addr(seL4_Word addr,
                                  seL4_Word type,
                                  seL4_Word size_bits,
@@ -774,7 +817,11 @@ seL4_CPtr cspace_save_reply_cap(cspace_t *c)
     
     seL4_CPtr slot;
     seL4_Error err;
-    slot = cspace_alloc_slot(c);
+    if (c->num_reply_slots > 0) {
+        slot = c->reply_slots[--c->num_reply_slots];
+    } else {
+        slot = cspace_alloc_slot(c);
+    }
     assert(slot != CSPACE_NULL);
     
     err = seL4_CNode_SaveCaller(c->root_cnode, 
@@ -784,6 +831,31 @@ seL4_CPtr cspace_save_reply_cap(cspace_t *c)
     
     return slot;
 }
+
+cspace_err_t cspace_free_reply_cap(cspace_t *c, seL4_CPtr slot)
+{
+    seL4_Error err;
+    assert(c != NULL);
+    assert(slot != CSPACE_NULL);
+
+    /*
+     * The reply cap is gone if it was used, but not if the caller was never replied to (e.g. it
+     * was killed in the meantime). Deleting an empty slot is harmless, so always do it to make
+     * sure the slot can be saved into again.
+     */
+    err = seL4_CNode_Delete(c->root_cnode, slot, CSPACE_DEPTH);
+    sel4_error(err, "Deleting reply cap");
+    if (err != seL4_NoError) {
+        return CSPACE_ERROR;
+    }
+
+    if (c->num_reply_slots < CSPACE_REPLY_POOL_SIZE) {
+        c->reply_slots[c->num_reply_slots++] = slot;
+        return CSPACE_NOERROR;
+    }
+    return cspace_free_slot(c, slot);
+}
+
 seL4_CPtr cspace_irq_control_get_cap(cspace_t *dest, 
                                      seL4_IRQControl irq_cap, 
                                      int irq)
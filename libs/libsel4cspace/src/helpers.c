@@ -50,61 +50,71 @@ cspace_err_t cspace_free_level1_index(cspace_t *c, int32_t s)
     return CSPACE_NOERROR;
 }
 
-seL4_CPtr cspace_alloc_level2_slot(cspace_t *c)
+/*
+ * Allocate a new level 2 cnode and put all its slots on the front of the free list.
+ */
+static void cspace_add_level2_node(cspace_t *c)
 {
-    seL4_CPtr s, ut_cptr;
+    seL4_CPtr ut_cptr;
     uint32_t i,j,offset,v;
     seL4_CPtr l1;
     cspace_err_t cerr;
     seL4_Error serr;
 
-    if (c->num_free_slots <= 0) {
-	/* allocate a new level 2 cnode here */        
-        l1 = cspace_alloc_level1_index(c);
-        assert(l1 != CSPACE_NOSLOT);
-        
-        v = cspace_ut_alloc(CSPACE_NODE_SIZE_IN_MEM_BITS);
-        assert (v != 0);
-        cerr = cspace_ut_translate(v, &ut_cptr, &offset);
-        assert (cerr == CSPACE_NOERROR);
-        c->level1_alloc_table[l1] = v; /* save the phys address for later free */
+    l1 = cspace_alloc_level1_index(c);
+    assert(l1 != CSPACE_NOSLOT);
+    
+    v = cspace_ut_alloc(CSPACE_NODE_SIZE_IN_MEM_BITS);
+    assert (v != 0);
+    cerr = cspace_ut_translate(v, &ut_cptr, &offset);
+    assert (cerr == CSPACE_NOERROR);
+    c->level1_alloc_table[l1] = v; /* save the phys address for later free */
 
-        
-        serr = seL4_Untyped_RetypeAtOffset(ut_cptr,
-                                           seL4_CapTableObject,
-                                           offset,
-                                           CSPACE_NODE_SIZE_IN_SLOTS_BITS,
-                                           c->root_cnode,
-                                           0, 
-                                           0,
-                                           l1,
-                                           1);
-        assert(serr == seL4_NoError);
-        
-        for (j = (l1 << CSPACE_NODE_SIZE_IN_SLOTS_BITS), i = j >> CSPACE_NODE_SIZE_IN_SLOTS_BITS;
-             j < ((l1 +1) << CSPACE_NODE_SIZE_IN_SLOTS_BITS)-1;
-             j++) {
-            if ((j & (CSPACE_NODE_SIZE_IN_SLOTS -1)) == 0) {
-                i = j >> CSPACE_NODE_SIZE_IN_SLOTS_BITS;
-                c->level2_alloc_tables[i] = 
-                    cspace_malloc(sizeof(uint32_t)*CSPACE_NODE_SIZE_IN_SLOTS);
+    
+    serr = seL4_Untyped_RetypeAtOffset(ut_cptr,
+                                       seL4_CapTableObject,
+                                       offset,
+                                       CSPACE_NODE_SIZE_IN_SLOTS_BITS,
+                                       c->root_cnode,
+                                       0, 
+                                       0,
+                                       l1,
+                                       1);
+    assert(serr == seL4_NoError);
+    
+    for (j = (l1 << CSPACE_NODE_SIZE_IN_SLOTS_BITS), i = j >> CSPACE_NODE_SIZE_IN_SLOTS_BITS;
+         j < ((l1 +1) << CSPACE_NODE_SIZE_IN_SLOTS_BITS)-1;
+         j++) {
+        if ((j & (CSPACE_NODE_SIZE_IN_SLOTS -1)) == 0) {
+            i = j >> CSPACE_NODE_SIZE_IN_SLOTS_BITS;
+            c->level2_alloc_tables[i] = 
+                cspace_malloc(sizeof(uint32_t)*CSPACE_NODE_SIZE_IN_SLOTS);
 #ifdef CSPACE_DEBUG
-                printf("cspace: malloc bookkeeping for leaf node %d\n",i);
+            printf("cspace: malloc bookkeeping for leaf node %d\n",i);
 #endif
-                assert(c->level2_alloc_tables[i]);
-            }
-            c->level2_alloc_tables[i][j & (CSPACE_NODE_SIZE_IN_SLOTS -1)] = j+1; 
-            
+            assert(c->level2_alloc_tables[i]);
         }
-        c->level2_alloc_tables[i][j & (CSPACE_NODE_SIZE_IN_SLOTS -1)] = CSPACE_NULL; 
-
-        c->num_free_slots = CSPACE_NODE_SIZE_IN_SLOTS;
-        c->next_level2_free_slot = l1 << CSPACE_NODE_SIZE_IN_SLOTS_BITS;
+        c->level2_alloc_tables[i][j & (CSPACE_NODE_SIZE_IN_SLOTS -1)] = j+1; 
         
+    }
+    /* the new slots go in front of whatever is still free */
+    c->level2_alloc_tables[i][j & (CSPACE_NODE_SIZE_IN_SLOTS -1)] = c->next_level2_free_slot;
+
+    c->num_free_slots += CSPACE_NODE_SIZE_IN_SLOTS;
+    c->next_level2_free_slot = l1 << CSPACE_NODE_SIZE_IN_SLOTS_BITS;
+    
 #ifdef CSPACE_DEBUG
     printf("cspace: free slots %d\n",  c->num_free_slots);
 #endif
+}
+
+seL4_CPtr cspace_alloc_level2_slot(cspace_t *c)
+{
+    seL4_CPtr s;
 
+    if (c->num_free_slots <= 0) {
+	/* allocate a new level 2 cnode here */        
+        cspace_add_level2_node(c);
     }
     s = c->next_level2_free_slot;
     c->next_level2_free_slot = c->level2_alloc_tables[s>>CSPACE_NODE_SIZE_IN_SLOTS_BITS]
@@ -124,3 +134,45 @@ cspace_err_t cspace_free_level2_slot(cspace_t *c, seL4_CPtr s)
 
     return CSPACE_NOERROR;
 }
+
+cspace_err_t cspace_alloc_level2_slots(cspace_t *c, size_t n, seL4_CPtr *slots)
+{
+    seL4_CPtr s;
+    size_t k;
+
+    /* make room for all of them up front, so the free list only has to be walked once */
+    while (c->num_free_slots < n) {
+        if (c->next_level1_free_index == CSPACE_NOSLOT) {
+            return CSPACE_ERROR;
+        }
+        cspace_add_level2_node(c);
+    }
+
+    s = c->next_level2_free_slot;
+    for (k = 0; k < n; k++) {
+        slots[k] = s;
+        s = c->level2_alloc_tables[s>>CSPACE_NODE_SIZE_IN_SLOTS_BITS][CSPACE_LEAF_OFFSET(s)];
+    }
+    c->next_level2_free_slot = s;
+    c->num_free_slots -= n;
+
+    return CSPACE_NOERROR;
+}
+
+cspace_err_t cspace_free_level2_slots(cspace_t *c, size_t n, const seL4_CPtr *slots)
+{
+    seL4_CPtr s = c->next_level2_free_slot;
+    size_t k;
+
+    /* chain the slots together back to front, then splice the chain onto the free list */
+    for (k = n; k > 0; k--) {
+        assert(slots[k - 1] < (CSPACE_NODE_SIZE_IN_SLOTS * CSPACE_NODE_SIZE_IN_SLOTS));
+        c->level2_alloc_tables[slots[k - 1]>>CSPACE_NODE_SIZE_IN_SLOTS_BITS]
+            [CSPACE_LEAF_OFFSET(slots[k - 1])] = s;
+        s = slots[k - 1];
+    }
+    c->next_level2_free_slot = s;
+    c->num_free_slots += n;
+
+    return CSPACE_NOERROR;
+}
@@ -31,9 +31,11 @@ extern cspace_free_t cspace_free;
 
 int32_t cspace_alloc_level1_index(cspace_t *c);
 seL4_CPtr cspace_alloc_level2_slot(cspace_t *c);
+cspace_err_t cspace_alloc_level2_slots(cspace_t *c, size_t n, seL4_CPtr *slots);
 cspace_err_t cspace_free_slot(cspace_t *c, seL4_CPtr slot);
 cspace_err_t cspace_free_level1_index(cspace_t *c, int32_t s);
 cspace_err_t cspace_free_level2_slot(cspace_t *c, seL4_CPtr s);
+cspace_err_t cspace_free_level2_slots(cspace_t *c, size_t n, const seL4_CPtr *slots);
 int cspace_retype_depth(cspace_t *cur_cspace);
 
 
@@ -20,6 +20,13 @@
 /* System calls for SOS */
 #define SYS_process_create     0x10000
 #define SYS_sos_process_status 0x10001
+#define SYS_sos_ring_setup     0x10002
+#define SYS_sos_ring_enter     0x10003
+#define SYS_sos_inline_stat64  0x10004
+#define SYS_sos_inline_open    0x10005
+#define SYS_sos_inline_read    0x10006
+#define SYS_sos_inline_write   0x10007
+#define SYS_copy_file_range    0x10008
 
 /* Endpoint for talking to SOS */
 #define SOS_IPC_EP_CAP     (0x1)
@@ -30,6 +37,11 @@
 #define MAX_IO_BUF 0x1000
 #define N_NAME 32
 
+/* Largest payload passed directly in the IPC buffer by the inline syscalls.
+ * It goes after the syscall number and up to two arguments */
+#define SOS_INLINE_MAX ((seL4_MsgMaxLength - 3) * sizeof(seL4_Word))
+#define SOS_INLINE_WORDS(bytes) (((bytes) + sizeof(seL4_Word) - 1) / sizeof(seL4_Word))
+
 /* file modes */
 #define FM_EXEC  1
 #define FM_WRITE 2
@@ -137,6 +149,132 @@ void sos_sys_usleep(int msec);
 /* Sleeps for the specified number of milliseconds.
  */
 
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags);
+/* Copies up to "len" bytes from "fd_in" to "fd_out" without passing them
+ * through the caller. Each offset is where to start in that file and is
+ * updated afterwards, or NULL to use and update the file's own offset.
+ * "flags" must be 0. Returns the number of bytes copied, 0 at end of file,
+ * -1 on error.
+ */
+
+
+/* Shared time page
+ *
+ * SOS maps a read-only page at SOS_TIME_PAGE into every process, along with
+ * the timer's registers at SOS_TIME_REGISTERS. This lets clock_gettime() work
+ * out the time without a system call. SOS increments "sequence" before and
+ * after changing the page, so a reader retries if it was odd or changed
+ * while reading.
+ */
+
+#define SOS_TIME_PAGE      0x0fffe000
+#define SOS_TIME_REGISTERS (SOS_TIME_PAGE + 0x1000)
+
+typedef struct {
+  uint32_t sequence;
+  uint64_t counter_zero;   /* Microseconds since boot when the counter was 0 */
+  uint32_t counter_offset; /* Of the microsecond counter in the register page */
+  uint32_t status_offset;  /* Of the status register */
+  uint32_t overflow_mask;  /* Status bit set while a counter overflow hasn't
+                            * been accounted for in "counter_zero" yet */
+} sos_time_page_t;
+
+
+/* Asynchronous system calls
+ *
+ * A process can queue up system calls in a submission ring shared with SOS,
+ * and have SOS start all of them with a single sos_ring_enter(). Results are
+ * posted to a completion ring as each call finishes, in whatever order that
+ * happens. Both rings live in a single page that SOS maps into the process.
+ */
+
+#define SOS_RING_ENTRIES 64 /* Must be a power of two */
+#define SOS_RING_MAX_ARGS 6
+
+typedef struct {
+  seL4_Word number;                  /* SYS_* of the call */
+  seL4_Word user_data;               /* Passed back unchanged on completion */
+  seL4_Word args[SOS_RING_MAX_ARGS]; /* Same as for the synchronous call */
+} sos_ring_sqe_t;
+
+typedef struct {
+  seL4_Word user_data;
+  int       result;                  /* What the call returned, or -errno */
+} sos_ring_cqe_t;
+
+typedef struct {
+  /* Free running indices. Each one is only written by one side: the
+   * process owns sq_tail and cq_head, SOS owns sq_head and cq_tail */
+  uint32_t sq_head;
+  uint32_t sq_tail;
+  uint32_t cq_head;
+  uint32_t cq_tail;
+
+  sos_ring_sqe_t sq[SOS_RING_ENTRIES];
+  sos_ring_cqe_t cq[SOS_RING_ENTRIES];
+} sos_ring_t;
+
+sos_ring_t *sos_ring_setup(void);
+/* Maps the rings into the calling process. Only one set of rings is allowed
+ * per process. Returns NULL on error.
+ */
+
+sos_ring_sqe_t *sos_ring_next_sqe(sos_ring_t *ring);
+/* Returns the next free submission entry to fill in, or NULL if the
+ * submission ring is full. The entry is queued by sos_ring_queue_sqe().
+ */
+
+void sos_ring_queue_sqe(sos_ring_t *ring);
+/* Queues the entry returned by the last sos_ring_next_sqe(). */
+
+int sos_ring_enter(unsigned min_complete);
+/* Starts every queued submission (as far as there is room in the completion
+ * ring for the results), then waits until at least "min_complete" completions
+ * are available. Returns the number of completions available, -1 on error.
+ */
+
+int sos_ring_next_cqe(sos_ring_t *ring, sos_ring_cqe_t *cqe);
+/* Takes the oldest completion into "cqe". Returns 1 if there was one, 0 if
+ * the completion ring is empty.
+ */
+
+
+/* Locks
+ *
+ * Threads sleep in SOS on a word of their memory with futex(). SOS finds
+ * waiters by where the word is in physical memory, so the word can be in
+ * memory shared between processes too. musl's pthread mutexes use the same
+ * operations.
+ */
+
+#ifndef FUTEX_WAIT
+#define FUTEX_WAIT         0
+#define FUTEX_WAKE         1
+#define FUTEX_PRIVATE_FLAG 128
+#endif
+
+typedef struct {
+  int state;                         /* 0 unlocked, 1 locked, 2 locked with
+                                      * (possibly) someone waiting */
+} sos_mutex_t;
+
+#define SOS_MUTEX_INITIALIZER {0}
+
+void sos_mutex_lock(sos_mutex_t *mutex);
+/* Takes the lock, sleeping until it's free if needed. Only makes a system
+ * call if the lock is already held.
+ */
+
+int sos_mutex_trylock(sos_mutex_t *mutex);
+/* Takes the lock if it's free. Returns 0 if it was taken, -1 (with errno set
+ * to EBUSY) otherwise.
+ */
+
+void sos_mutex_unlock(sos_mutex_t *mutex);
+/* Releases the lock. Only makes a system call if someone might be waiting.
+ */
+
 
 /*************************************************************************/
 /*                                   */
@@ -1,4 +1,6 @@
+#define _GNU_SOURCE
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <assert.h>
 #include <dirent.h>
@@ -11,19 +13,28 @@
 #include <unistd.h>
 
 #include "sos.h"
+#include "syscall.h"
 
 __attribute__((__constructor__))
 static void open_console(void) {
-    // The spec is very picky in what is open at process start
-    close(STDIN_FILENO);
-    close(STDOUT_FILENO);
-    close(STDERR_FILENO);
+    // The spec is very picky in what is open at process start: stdin closed,
+    // and stdout and stderr on the console. Streams the parent redirected
+    // somewhere else (such as a pipe) are left alone though
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; ++fd) {
+        if (fcntl(fd, F_GETFD) != -1 && !isatty(fd))
+            continue;
 
-    // XXX: dup2() not implemented, so this will have to do
-    assert(open("console", O_RDONLY) == STDIN_FILENO);
-    assert(open("console", O_WRONLY) == STDOUT_FILENO);
-    assert(open("console", O_WRONLY) == STDERR_FILENO);
-    close(STDIN_FILENO);
+        close(fd);
+        if (fd == STDIN_FILENO)
+            continue;
+
+        int console = open("console", O_WRONLY);
+        assert(console != -1);
+        if (console != fd) {
+            assert(dup2(console, fd) == fd);
+            close(console);
+        }
+    }
 }
 
 static long posix_to_sos_time(struct timespec time) {
@@ -162,7 +173,7 @@ pid_t sos_process_wait(pid_t pid) {
 
 int64_t sos_sys_time_stamp(void) {
     struct timespec timespec;
-    if (!clock_gettime(CLOCK_REALTIME, &timespec))
+    if (clock_gettime(CLOCK_MONOTONIC, &timespec))
         return -1;
 
     return (int64_t)timespec.tv_sec * 1000000 + (int64_t)timespec.tv_nsec / 1000;
@@ -175,6 +186,25 @@ void sos_sys_usleep(int msec) {
     nanosleep(&timespec, NULL);
 }
 
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags) {
+    seL4_SetMR(0, SYS_copy_file_range);
+    seL4_SetMR(1, (seL4_Word)fd_in);
+    seL4_SetMR(2, (seL4_Word)off_in);
+    seL4_SetMR(3, (seL4_Word)fd_out);
+    seL4_SetMR(4, (seL4_Word)off_out);
+    seL4_SetMR(5, (seL4_Word)len);
+    seL4_SetMR(6, (seL4_Word)flags);
+
+    ssize_t result = sos_call(7);
+    if (result < 0) {
+        errno = -result;
+        return -1;
+    } else {
+        return result;
+    }
+}
+
 int sos_share_vm(void *adr, size_t size, int writable) {
     (void)adr;
     (void)size;
@@ -184,3 +214,85 @@ int sos_share_vm(void *adr, size_t size, int writable) {
     errno = ENOSYS;
     return -1;
 }
+
+sos_ring_t *sos_ring_setup(void) {
+    seL4_SetMR(0, SYS_sos_ring_setup);
+
+    seL4_MessageInfo_t req = seL4_MessageInfo_new(seL4_NoFault, 0, 0, 1);
+    seL4_Call(SOS_IPC_EP_CAP, req);
+
+    int result = (int)seL4_GetMR(0);
+    if (result < 0 && result > -4096) {
+        errno = -result;
+        return NULL;
+    } else {
+        return (sos_ring_t *)result;
+    }
+}
+
+sos_ring_sqe_t *sos_ring_next_sqe(sos_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_tail - head == SOS_RING_ENTRIES)
+        return NULL;
+
+    return &ring->sq[ring->sq_tail & (SOS_RING_ENTRIES - 1)];
+}
+
+void sos_ring_queue_sqe(sos_ring_t *ring) {
+    __atomic_store_n(&ring->sq_tail, ring->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+int sos_ring_enter(unsigned min_complete) {
+    seL4_SetMR(0, SYS_sos_ring_enter);
+    seL4_SetMR(1, (seL4_Word)min_complete);
+
+    seL4_MessageInfo_t req = seL4_MessageInfo_new(seL4_NoFault, 0, 0, 2);
+    seL4_Call(SOS_IPC_EP_CAP, req);
+
+    int result = (int)seL4_GetMR(0);
+    if (result < 0) {
+        errno = -result;
+        return -1;
+    } else {
+        return result;
+    }
+}
+
+int sos_ring_next_cqe(sos_ring_t *ring, sos_ring_cqe_t *cqe) {
+    uint32_t tail = __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (ring->cq_head == tail)
+        return 0;
+
+    *cqe = ring->cq[ring->cq_head & (SOS_RING_ENTRIES - 1)];
+    __atomic_store_n(&ring->cq_head, ring->cq_head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void sos_mutex_lock(sos_mutex_t *mutex) {
+    int state = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    // Contended, so mark that there's a waiter before sleeping. Whoever
+    // unlocks will then wake someone up
+    if (state != 2)
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    while (state != 0) {
+        syscall(SYS_futex, &mutex->state, FUTEX_WAIT, 2, NULL);
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+int sos_mutex_trylock(sos_mutex_t *mutex) {
+    int state = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+
+    errno = EBUSY;
+    return -1;
+}
+
+void sos_mutex_unlock(sos_mutex_t *mutex) {
+    if (__atomic_exchange_n(&mutex->state, 0, __ATOMIC_RELEASE) == 2)
+        syscall(SYS_futex, &mutex->state, FUTEX_WAKE, 1);
+}
@@ -5,3 +5,6 @@ FORWARD_SYSCALL(waitid, 4);
 FORWARD_SYSCALL(wait4, 4);
 FORWARD_SYSCALL(kill, 2);
 FORWARD_SYSCALL(exit_group, 1);
+FORWARD_SYSCALL(getpriority, 2);
+FORWARD_SYSCALL(setpriority, 3);
+FORWARD_SYSCALL(nice, 1);
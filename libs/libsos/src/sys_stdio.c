@@ -1,20 +1,133 @@
+#include <string.h>
+#include <sys/stat.h>
+
 #include "syscall.h"
 
-FORWARD_SYSCALL(stat64, 2);
-FORWARD_SYSCALL(open, 3);
+// Small payloads go directly in the IPC buffer after the arguments, which
+// saves SOS from mapping in our memory to get at them
+
+static void* inline_payload(size_t argc) {
+    return &seL4_GetIPCBuffer()->msg[argc + 1];
+}
+
+int sys_stat64(va_list ap) {
+    const char* pathname = va_arg(ap, const char*);
+    struct stat* buf = va_arg(ap, struct stat*);
+
+    size_t length = strnlen(pathname, SOS_INLINE_MAX) + 1;
+    if (length > SOS_INLINE_MAX) {
+        seL4_SetMR(0, SYS_stat64);
+        seL4_SetMR(1, (seL4_Word)pathname);
+        seL4_SetMR(2, (seL4_Word)buf);
+        return sos_call(3);
+    }
+
+    seL4_SetMR(0, SYS_sos_inline_stat64);
+    memcpy(inline_payload(0), pathname, length);
+
+    int result = sos_call(1 + SOS_INLINE_WORDS(length));
+    if (result == 0)
+        memcpy(buf, inline_payload(0), sizeof(*buf));
+    return result;
+}
+
+int sys_open(va_list ap) {
+    const char* pathname = va_arg(ap, const char*);
+    int flags = va_arg(ap, int);
+    mode_t mode = va_arg(ap, mode_t);
+
+    size_t length = strnlen(pathname, SOS_INLINE_MAX) + 1;
+    if (length > SOS_INLINE_MAX) {
+        seL4_SetMR(0, SYS_open);
+        seL4_SetMR(1, (seL4_Word)pathname);
+        seL4_SetMR(2, flags);
+        seL4_SetMR(3, mode);
+        return sos_call(4);
+    }
+
+    seL4_SetMR(0, SYS_sos_inline_open);
+    seL4_SetMR(1, flags);
+    seL4_SetMR(2, mode);
+    memcpy(inline_payload(2), pathname, length);
+    return sos_call(3 + SOS_INLINE_WORDS(length));
+}
+
 FORWARD_SYSCALL(close, 1);
 
-FORWARD_SYSCALL(read, 3);
+FORWARD_SYSCALL(pipe, 1);
+FORWARD_SYSCALL(pipe2, 2);
+FORWARD_SYSCALL(dup, 1);
+FORWARD_SYSCALL(dup2, 2);
+FORWARD_SYSCALL(dup3, 3);
+
+int sys_read(va_list ap) {
+    int fd = va_arg(ap, int);
+    void* buf = va_arg(ap, void*);
+    size_t count = va_arg(ap, size_t);
+
+    if (count > SOS_INLINE_MAX) {
+        seL4_SetMR(0, SYS_read);
+        seL4_SetMR(1, fd);
+        seL4_SetMR(2, (seL4_Word)buf);
+        seL4_SetMR(3, count);
+        return sos_call(4);
+    }
+
+    seL4_SetMR(0, SYS_sos_inline_read);
+    seL4_SetMR(1, fd);
+    seL4_SetMR(2, count);
+
+    int result = sos_call(3);
+    if (result > 0)
+        memcpy(buf, inline_payload(0), result);
+    return result;
+}
+
 FORWARD_SYSCALL(readv, 3);
 FORWARD_SYSCALL(pread64, 6);
 FORWARD_SYSCALL(preadv, 6);
 
-FORWARD_SYSCALL(write, 3);
+int sys_write(va_list ap) {
+    int fd = va_arg(ap, int);
+    const void* buf = va_arg(ap, const void*);
+    size_t count = va_arg(ap, size_t);
+
+    if (count > SOS_INLINE_MAX) {
+        seL4_SetMR(0, SYS_write);
+        seL4_SetMR(1, fd);
+        seL4_SetMR(2, (seL4_Word)buf);
+        seL4_SetMR(3, count);
+        return sos_call(4);
+    }
+
+    seL4_SetMR(0, SYS_sos_inline_write);
+    seL4_SetMR(1, fd);
+    seL4_SetMR(2, count);
+    memcpy(inline_payload(2), buf, count);
+    return sos_call(3 + SOS_INLINE_WORDS(count));
+}
+
 FORWARD_SYSCALL(writev, 3);
 FORWARD_SYSCALL(pwrite64, 6);
 FORWARD_SYSCALL(pwritev, 6);
 
+// musl's off_t is always 64 bits, so its sendfile() already passes the offset
+// the way sendfile64 wants it
+int sys_sendfile(va_list ap) {
+    seL4_SetMR(0, SYS_sendfile64);
+    for (size_t a = 0; a < 4; ++a)
+        seL4_SetMR(a + 1, va_arg(ap, seL4_Word));
+    return sos_call(5);
+}
+FORWARD_SYSCALL(sendfile64, 4);
+
 FORWARD_SYSCALL(getdents64, 3);
 
 FORWARD_SYSCALL(fcntl64, 3);
 FORWARD_SYSCALL(ioctl, 3);
+
+FORWARD_SYSCALL(poll, 3);
+FORWARD_SYSCALL(epoll_create, 1);
+FORWARD_SYSCALL(epoll_create1, 1);
+FORWARD_SYSCALL(epoll_ctl, 4);
+FORWARD_SYSCALL(epoll_wait, 4);
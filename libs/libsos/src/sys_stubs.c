@@ -1809,11 +1809,11 @@ long sys_pause()
     assert(!"sys_access not implemented");
     __builtin_unreachable();
 }*/
-long sys_nice()
+/*long sys_nice()
 {
     assert(!"sys_nice not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_sync()
 {
     assert(!"sys_sync not implemented");
@@ -1839,16 +1839,16 @@ long sys_rmdir()
     assert(!"sys_rmdir not implemented");
     __builtin_unreachable();
 }
-long sys_dup()
+/*long sys_dup()
 {
     assert(!"sys_dup not implemented");
     __builtin_unreachable();
-}
-long sys_pipe()
+}*/
+/*long sys_pipe()
 {
     assert(!"sys_pipe not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_times()
 {
     assert(!"sys_times not implemented");
@@ -1917,11 +1917,11 @@ long sys_ustat()
     assert(!"sys_ustat not implemented");
     __builtin_unreachable();
 }
-long sys_dup2()
+/*long sys_dup2()
 {
     assert(!"sys_dup2 not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_getppid()
 {
     assert(!"sys_getppid not implemented");
@@ -2047,16 +2047,16 @@ long sys_fchown()
     assert(!"sys_fchown not implemented");
     __builtin_unreachable();
 }
-long sys_getpriority()
+/*long sys_getpriority()
 {
     assert(!"sys_getpriority not implemented");
     __builtin_unreachable();
-}
-long sys_setpriority()
+}*/
+/*long sys_setpriority()
 {
     assert(!"sys_setpriority not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_statfs()
 {
     assert(!"sys_statfs not implemented");
@@ -2127,11 +2127,11 @@ long sys_sigreturn()
     assert(!"sys_sigreturn not implemented");
     __builtin_unreachable();
 }
-long sys_clone()
+/*long sys_clone()
 {
     assert(!"sys_clone not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_setdomainname()
 {
     assert(!"sys_setdomainname not implemented");
@@ -2321,11 +2321,11 @@ long sys_getresuid()
     assert(!"sys_getresuid not implemented");
     __builtin_unreachable();
 }
-long sys_poll()
+/*long sys_poll()
 {
     assert(!"sys_poll not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_nfsservctl()
 {
     assert(!"sys_nfsservctl not implemented");
@@ -2416,11 +2416,11 @@ long sys_sigaltstack()
     assert(!"sys_sigaltstack not implemented");
     __builtin_unreachable();
 }
-long sys_sendfile()
+/*long sys_sendfile()
 {
     assert(!"sys_sendfile not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_vfork()
 {
     assert(!"sys_vfork not implemented");
@@ -2655,16 +2655,16 @@ long sys_fremovexattr()
     assert(!"sys_tkill not implemented");
     __builtin_unreachable();
 }*/
-long sys_sendfile64()
+/*long sys_sendfile64()
 {
     assert(!"sys_sendfile64 not implemented");
     __builtin_unreachable();
-}
-long sys_futex()
+}*/
+/*long sys_futex()
 {
     assert(!"sys_futex not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_sched_setaffinity()
 {
     assert(!"sys_sched_setaffinity not implemented");
@@ -2710,21 +2710,21 @@ long sys_lookup_dcookie()
     assert(!"sys_lookup_dcookie not implemented");
     __builtin_unreachable();
 }
-long sys_epoll_create()
+/*long sys_epoll_create()
 {
     assert(!"sys_epoll_create not implemented");
     __builtin_unreachable();
-}
-long sys_epoll_ctl()
+}*/
+/*long sys_epoll_ctl()
 {
     assert(!"sys_epoll_ctl not implemented");
     __builtin_unreachable();
-}
-long sys_epoll_wait()
+}*/
+/*long sys_epoll_wait()
 {
     assert(!"sys_epoll_wait not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_remap_file_pages()
 {
     assert(!"sys_remap_file_pages not implemented");
@@ -3235,21 +3235,21 @@ long sys_eventfd2()
     assert(!"sys_eventfd2 not implemented");
     __builtin_unreachable();
 }
-long sys_epoll_create1()
+/*long sys_epoll_create1()
 {
     assert(!"sys_epoll_create1 not implemented");
     __builtin_unreachable();
-}
-long sys_dup3()
+}*/
+/*long sys_dup3()
 {
     assert(!"sys_dup3 not implemented");
     __builtin_unreachable();
-}
-long sys_pipe2()
+}*/
+/*long sys_pipe2()
 {
     assert(!"sys_pipe2 not implemented");
     __builtin_unreachable();
-}
+}*/
 long sys_inotify_init1()
 {
     assert(!"sys_inotify_init1 not implemented");
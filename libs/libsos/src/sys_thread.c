@@ -8,12 +8,10 @@ int sys_rt_sigprocmask() {
     return 0;
 }
 
-pid_t sys_set_tid_address() {
-    // XXX: Dummy function - but muslc needs it
-    return syscall(SYS_gettid);
-}
-
+FORWARD_SYSCALL(clone, 6);
+FORWARD_SYSCALL(futex, 4);
 FORWARD_SYSCALL(gettid, 0);
+FORWARD_SYSCALL(set_tid_address, 1);
 FORWARD_SYSCALL(tkill, 2);
 FORWARD_SYSCALL(tgkill, 3);
 FORWARD_SYSCALL(exit, 1);
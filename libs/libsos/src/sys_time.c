@@ -1,4 +1,52 @@
+#include <errno.h>
+#include <time.h>
+
 #include "syscall.h"
 
-FORWARD_SYSCALL(clock_gettime, 2);
+// Microseconds since boot, read straight from the shared time page
+static uint64_t time_page_now(void) {
+    const sos_time_page_t* page = (const sos_time_page_t*)SOS_TIME_PAGE;
+    const volatile uint8_t* registers = (const volatile uint8_t*)SOS_TIME_REGISTERS;
+
+    while (1) {
+        uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1)
+            continue;
+
+        const volatile uint32_t* status = (const volatile uint32_t*)(registers + page->status_offset);
+        const volatile uint32_t* counter = (const volatile uint32_t*)(registers + page->counter_offset);
+        uint32_t overflowMask = page->overflow_mask;
+
+        uint64_t now = page->counter_zero;
+        int isAlreadyOverflowed = *status & overflowMask;
+        now += *counter;
+
+        // Same as what SOS does: an overflow that SOS hasn't handled yet
+        // means we're another full counter period ahead, but if it happened
+        // while reading the counter we can't tell which side we read it on
+        if (isAlreadyOverflowed)
+            now += 0x100000000ULL;
+        else if (*status & overflowMask)
+            continue;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == sequence)
+            return now;
+    }
+}
+
+int sys_clock_gettime(va_list ap) {
+    clockid_t clk_id = va_arg(ap, clockid_t);
+    struct timespec* tp = va_arg(ap, struct timespec*);
+
+    // There's no wall clock, so real time is also time since boot
+    if (clk_id != CLOCK_REALTIME && clk_id != CLOCK_MONOTONIC)
+        return -EINVAL;
+
+    uint64_t now = time_page_now();
+    tp->tv_sec = now / 1000000;
+    tp->tv_nsec = (now % 1000000) * 1000;
+    return 0;
+}
+
 FORWARD_SYSCALL(nanosleep, 2);
@@ -7,6 +7,14 @@
 #include <sel4/sel4.h>
 #include <sos.h>
 
+// Sends the syscall set up in the first `length` message registers, returning
+// MR 0 of the reply
+static inline int sos_call(size_t length) {
+    seL4_MessageInfo_t req = seL4_MessageInfo_new(seL4_NoFault, 0, 0, length);
+    seL4_Call(SOS_IPC_EP_CAP, req);
+    return seL4_GetMR(0);
+}
+
 #define FORWARD_SYSCALL(name, argc)                                                  \
     int sys_##name(va_list ap) {                                                     \
         seL4_SetMR(0, SYS_##name);                                                   \
@@ -15,7 +23,5 @@
             seL4_SetMR(a + 1, va_arg(ap, seL4_Word));                                \
         _Pragma("GCC diagnostic pop");                                               \
                                                                                      \
-        seL4_MessageInfo_t req = seL4_MessageInfo_new(seL4_NoFault, 0, 0, argc + 1); \
-        seL4_Call(SOS_IPC_EP_CAP, req);                                              \
-        return seL4_GetMR(0);                                                        \
+        return sos_call(argc + 1);                                                   \
     }